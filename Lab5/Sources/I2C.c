@@ -17,30 +17,47 @@
 #include "Cpu.h"
 #include "brOS.h"
 
-//// FSM for stages in I2C_IntRead
-//typedef enum
-//{
-//  STAGE_START,
-//  STAGE_REGISTER_ADDRESS,
-//  STAGE_REPEAT_START,
-//  STAGE_RECEIVE_MODE,
-//  STAGE_DUMMY_READ,
-//  STAGE_READ_DATA,
-//  STAGE_READ_BYTE,
-//  STAGE_READ_SECOND_LAST_BYTE,
-//  STAGE_READ_LAST_BYTE
-//} TI2CIntReadStage;
+// eDMA channel for receive bursts, and its request source on DMA MUX 0 (K70 manual, DMA request sources)
+#define DMA_CHANNEL     0
+#define DMA_SOURCE_I2C0 22
+
+// A burst needs at least one byte for the DMA, leaving the last 2 to the interrupt for the NAK and STOP
+#define DMA_MIN_BYTES   3
+
+// Stages of a transaction, each one ends with an I2C interrupt
+typedef enum
+{
+  STAGE_SLAVE_ADDRESS,     // Slave address with W bit sent
+  STAGE_REGISTER_ADDRESS,  // Register address sent
+  STAGE_WRITE_DATA,        // Data byte sent
+  STAGE_REPEAT_START,      // Slave address with R bit sent after a repeat START
+  STAGE_READ_DATA          // A byte has been received
+} TI2CStage;
 
 // Private Global Variables
 static uint8_t SlaveAddress;
-static uint8_t* RxData;
-static uint8_t RxNbBytes;
 static void (*ReadCompleteCallback)(void* args);
 static void *ReadCompleteArguments;
-static bool ReadCompleted = true;
+
+// The transaction on the bus, and the ones waiting for it or for their callbacks
+static TI2CTransaction* volatile Current;
+static TI2CTransaction* QueueHead;
+static TI2CTransaction* QueueTail;
+static TI2CTransaction* DoneHead;
+static TI2CTransaction* DoneTail;
+static TI2CStage Stage;
+static uint8_t Index;                 // The next byte of the current transaction to send or receive
+static volatile bool WaitingForBus;   // TRUE if the current transaction has not started because the bus was busy
+
+// Transactions for the single device API
+static TI2CTransaction IntReadTransaction;
+static TI2CTransaction BlockingTransaction;
+static uint8_t WriteByte;
 
 // Semaphores
-static OS_ECB* CallCallback;
+static OS_ECB* CallCallback;          // Signalled when a transaction finishes
+static OS_ECB* BlockingCaller;        // Held by the thread using BlockingTransaction
+static OS_ECB* TransferComplete;      // Signalled when BlockingTransaction finishes
 
 // All possible SCL_DIVIDER values
 static const uint32_t SCL_DIVIDER[64] = {20, 22, 24, 26, 28, 30, 34, 40,
@@ -107,42 +124,173 @@ static void FrequencyDividerRegister(const uint32_t desiredBaudRate, const uint3
 }
 
 
-/*! @brief Waits for STOP signal if the bus is busy.
+/*! @brief Sends START signal to the bus.
  *
  */
-static void WaitForIdleBus(void)
+static void Start(void)
 {
-  while (I2C0_S & I2C_S_BUSY_MASK);
+  I2C0_C1 |= I2C_C1_MST_MASK;  // Enable master mode to generate start signal
+  I2C0_C1 |= I2C_C1_TX_MASK;   // Enable transmit mode
 }
 
 
-/*! @brief Waits for AK from slave.
+/*! @brief Sends STOP signal to the bus.
  *
  */
-static void WaitForAK(void)
+static void Stop(void)
 {
-  while (!(I2C0_S & I2C_S_IICIF_MASK));  // Wait for interrupt flag to be set
-  I2C0_S |= I2C_S_IICIF_MASK;             // w1c interrupt flag
+  I2C0_C1 &= ~I2C_C1_MST_MASK;  // Enable slave mode to generate stop signal
+  I2C0_C1 &= ~I2C_C1_TX_MASK;   // Enable receive mode
 }
 
 
-/*! @brief Sends START signal to the bus.
+/*! @brief Sends the slave address of the current transaction, the rest of it is run by the I2C interrupt.
  *
+ *  @param repeat TRUE to follow on from the last transaction with a repeat START, without giving up the bus.
+ *  @note Without a repeat START, a busy bus leaves the transaction waiting. There is no interrupt for the STOP
+ *        that frees the bus, so the next I2C_Submit or I2C_RxThread tries again.
  */
-static void Start(void)
+static void Begin(const bool repeat)
 {
-  I2C0_C1 |= I2C_C1_MST_MASK;  // Enable master mode to generate start signal
-  I2C0_C1 |= I2C_C1_TX_MASK;   // Enable transmit mode
+  Stage = STAGE_SLAVE_ADDRESS;
+  Index = 0;
+
+  // Follow Figure 11 in MMA8451Q data sheet
+
+  if (repeat)
+  {
+    I2C0_C1 |= I2C_C1_TX_MASK;           // Enable transmit mode
+    I2C0_C1 |= I2C_C1_RSTA_MASK;         // Generate Repeat START signal
+  }
+  else
+  {
+    // The STOP of the last transaction, or another master, still holds the bus
+    if (I2C0_S & I2C_S_BUSY_MASK)
+    {
+      I2C0_C1 &= ~I2C_C1_IICIE_MASK;     // Disable interrupts until the transaction starts
+      WaitingForBus = true;
+      OS_SemaphoreSignal(CallCallback);  // Signal the I2C_RxThread to try again
+      return;
+    }
+
+    WaitingForBus = false;
+    I2C0_S |= I2C_S_IICIF_MASK;          // w1c interrupt flag
+    I2C0_C1 |= I2C_C1_IICIE_MASK;        // Enable interrupts
+    Start();                             // Send START signal
+  }
+
+  I2C0_C1 &= ~I2C_C1_TXAK_MASK;          // Clear TXAK for AK
+  I2C0_D = (Current->slaveAddress << 1) & 0xFE;  // Write slave address to data register with W bit
 }
 
 
-/*! @brief Sends STOP signal to the bus.
+/*! @brief Sets up the eDMA channel for receive bursts.
  *
+ *  Each I2C data byte received raises a DMA request, the channel reads it into the buffer and so starts the next byte.
  */
-static void Stop(void)
+static void DMAInit(void)
 {
-  I2C0_C1 &= ~I2C_C1_MST_MASK;  // Enable slave mode to generate stop signal
-  I2C0_C1 &= ~I2C_C1_TX_MASK;   // Enable receive mode
+  SIM_SCGC6 |= SIM_SCGC6_DMAMUX0_MASK;
+  SIM_SCGC7 |= SIM_SCGC7_DMA_MASK;
+
+  DMAMUX0_CHCFG(DMA_CHANNEL) = 0;
+  DMA_CERQ = DMA_CERQ_CERQ(DMA_CHANNEL);
+
+  DMA_SADDR(DMA_CHANNEL)       = (uint32_t)&I2C0_D;
+  DMA_SOFF(DMA_CHANNEL)        = 0;
+  DMA_SLAST(DMA_CHANNEL)       = 0;
+  DMA_ATTR(DMA_CHANNEL)        = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);     // 8-bit reads and writes
+  DMA_NBYTES_MLNO(DMA_CHANNEL) = 1;                                         // One byte per request
+  DMA_DOFF(DMA_CHANNEL)        = 1;
+  DMA_DLAST_SGA(DMA_CHANNEL)   = 0;
+  DMA_CSR(DMA_CHANNEL)         = DMA_CSR_INTMAJOR_MASK | DMA_CSR_DREQ_MASK; // Interrupt and stop at the end of the burst
+
+  DMAMUX0_CHCFG(DMA_CHANNEL) = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(DMA_SOURCE_I2C0);
+
+  // NVIC DMA0: Vector=16   IRQ=0   non-IPR=0   0%32=0
+  NVICICPR0 = (1 << 0);    // Clear pending interrupts
+  NVICISER0 = (1 << 0);    // Enable interrupts
+}
+
+
+/*! @brief Hands the bytes of the current read, up to the second last one, to the eDMA channel.
+ *
+ *  @note Called from the I2C interrupt, in receive mode, before the dummy read.
+ */
+static void DMAStart(void)
+{
+  uint16_t nbBytes = Current->nbBytes - 2;
+
+  DMA_DADDR(DMA_CHANNEL)         = (uint32_t)Current->data;
+  DMA_CITER_ELINKNO(DMA_CHANNEL) = nbBytes;
+  DMA_BITER_ELINKNO(DMA_CHANNEL) = nbBytes;
+  DMA_SERQ = DMA_SERQ_SERQ(DMA_CHANNEL);
+
+  Index = nbBytes;                       // Where the interrupt takes over
+  I2C0_C1 &= ~I2C_C1_IICIE_MASK;         // No byte interrupts during the burst
+  I2C0_C1 |= I2C_C1_DMAEN_MASK;
+}
+
+
+/*! @brief Hands the current transaction over to I2C_RxThread, or wakes the thread waiting for it, and starts the next one in the queue.
+ *
+ *  @param succeeded TRUE if every byte of the transaction was acknowledged.
+ *  @note Called from the I2C interrupt. A read has already sent STOP if the queue was empty.
+ */
+static void Finish(const bool succeeded)
+{
+  bool holdingBus = I2C0_C1 & I2C_C1_MST_MASK;
+
+  Current->succeeded = succeeded;
+
+  if (Current == &BlockingTransaction)
+  {
+    // Woken from here rather than from I2C_RxThread, so a callback can make a blocking call itself
+    Current->busy = false;
+    OS_SemaphoreSignal(TransferComplete);
+  }
+  else
+  {
+    Current->next = NULL;
+    if (DoneTail)
+      DoneTail->next = Current;
+    else
+      DoneHead = Current;
+    DoneTail = Current;
+    OS_SemaphoreSignal(CallCallback);    // Signal the I2C_RxThread
+  }
+
+  Current = QueueHead;
+  if (Current)
+  {
+    QueueHead = Current->next;
+    if (!QueueHead)
+      QueueTail = NULL;
+
+    // Back-to-back transactions keep the bus, unless it was lost to another master
+    Begin(holdingBus);
+  }
+  else
+  {
+    if (holdingBus)
+      Stop();                            // Send STOP signal
+    I2C0_C1 &= ~I2C_C1_IICIE_MASK;       // Disable interrupts until the next transaction
+  }
+}
+
+
+/*! @brief Runs BlockingTransaction, the calling thread sleeps until it has finished.
+ *
+ *  @note The caller holds BlockingCaller.
+ */
+static void RunBlocking(void)
+{
+  BlockingTransaction.slaveAddress = SlaveAddress;
+  BlockingTransaction.completeCallbackFunction = NULL;
+  BlockingTransaction.completeCallbackArguments = NULL;
+
+  if (I2C_Submit(&BlockingTransaction))
+    OS_SemaphoreWait(TransferComplete, 0);
 }
 
 
@@ -154,8 +302,10 @@ bool I2C_Init(const TI2CModule* const aI2CModule, const uint32_t moduleClk)
   ReadCompleteCallback  = aI2CModule->readCompleteCallbackFunction;
   ReadCompleteArguments = aI2CModule->readCompleteCallbackArguments;
 
-  // Initialize semaphore
-  CallCallback = OS_SemaphoreCreate(0);
+  // Initialize semaphores
+  CallCallback     = OS_SemaphoreCreate(0);
+  BlockingCaller   = OS_SemaphoreCreate(1);
+  TransferComplete = OS_SemaphoreCreate(0);
 
   // Enable I2C and PORT E clocks
   SIM_SCGC4 |= SIM_SCGC4_IIC0_MASK;
@@ -169,6 +319,8 @@ bool I2C_Init(const TI2CModule* const aI2CModule, const uint32_t moduleClk)
   PORTE_PCR18 |= PORT_PCR_ODE_MASK;
   PORTE_PCR19 |= PORT_PCR_ODE_MASK;
 
+  DMAInit();
+
   // Get best MULT and ICR values for desired baud rate and write to Frequency Divider Register with acquired values
   FrequencyDividerRegister(aI2CModule->baudRate, moduleClk);
 
@@ -193,138 +345,210 @@ void I2C_SelectSlaveDevice(const uint8_t slaveAddress)
 }
 
 
-void I2C_Write(const uint8_t registerAddress, const uint8_t data)
+bool I2C_Submit(TI2CTransaction* const transaction)
 {
-  EnterCritical();
-
-  // Follow Figure 11 in MMA8451Q data sheet
+  if (transaction->busy || (transaction->read && (transaction->nbBytes == 0)) ||
+      (transaction->useDMA && (!transaction->read || (transaction->nbBytes < DMA_MIN_BYTES))))
+    return false;
 
-  WaitForIdleBus();                      // Wait for stop signal if bus is busy
+  transaction->busy = true;
+  transaction->next = NULL;
 
-  Start();                               // Send START signal
+  EnterCritical();
+  if (!Current)
+  {
+    // The bus is idle, start straight away
+    Current = transaction;
+    Begin(false);
+  }
+  else
+  {
+    if (QueueTail)
+      QueueTail->next = transaction;
+    else
+      QueueHead = transaction;
+    QueueTail = transaction;
+
+    if (WaitingForBus)
+      Begin(false);
+  }
+  ExitCritical();
 
-  I2C0_D = (SlaveAddress << 1) & 0xFE;   // Write slave address to data register with W bit
-  WaitForAK();                           // Wait for AK from slave
+  return true;
+}
 
-  I2C0_D = registerAddress;              // Write register address to data register
-  WaitForAK();                           // Wait for AK from slave
 
-  I2C0_D = data;                         // Write data to data register
-  WaitForAK();                           // Wait for AK from slave
+void I2C_Write(const uint8_t registerAddress, const uint8_t data)
+{
+  OS_SemaphoreWait(BlockingCaller, 0);
 
-  Stop();                                // Send STOP signal
+  WriteByte = data;
+  BlockingTransaction.registerAddress = registerAddress;
+  BlockingTransaction.read = false;
+  BlockingTransaction.data = &WriteByte;
+  BlockingTransaction.nbBytes = 1;
+  BlockingTransaction.useDMA = false;
+  RunBlocking();
 
-  ExitCritical();
+  OS_SemaphoreSignal(BlockingCaller);
 }
 
 
 void I2C_PollRead(const uint8_t registerAddress, uint8_t* const data, const uint8_t nbBytes)
 {
-  uint8_t dummy, i;                     // Local variables
+  if (nbBytes == 0)
+    return;
 
-  // Follow Figure 11 in MMA8451Q data sheet
+  OS_SemaphoreWait(BlockingCaller, 0);
 
-  WaitForIdleBus();                     // Wait for stop signal if bus is busy
+  BlockingTransaction.registerAddress = registerAddress;
+  BlockingTransaction.read = true;
+  BlockingTransaction.data = data;
+  BlockingTransaction.nbBytes = nbBytes;
+  BlockingTransaction.useDMA = (nbBytes >= DMA_MIN_BYTES);
+  RunBlocking();
 
-  I2C0_C1 &= ~I2C_C1_IICIE_MASK;        // Disable interrupts
+  OS_SemaphoreSignal(BlockingCaller);
 
-  Start();                              // Send START signal
+  if (ReadCompleteCallback)
+  {
+    (*ReadCompleteCallback)(ReadCompleteArguments);
+  }
+}
 
-  I2C0_D = (SlaveAddress << 1) & 0xFE;  // Write slave address to data register with W bit
-  WaitForAK();                          // Wait for AK from slave
 
-  I2C0_D = registerAddress;             // Write register address to data register
-  WaitForAK();                          // Wait for AK from slave
+void I2C_IntRead(const uint8_t registerAddress, uint8_t* const data, const uint8_t nbBytes)
+{
+  // A read still in progress is left to finish, this one is dropped
+  if (IntReadTransaction.busy)
+    return;
+
+  IntReadTransaction.slaveAddress = SlaveAddress;
+  IntReadTransaction.registerAddress = registerAddress;
+  IntReadTransaction.read = true;
+  IntReadTransaction.data = data;
+  IntReadTransaction.nbBytes = nbBytes;
+  IntReadTransaction.useDMA = (nbBytes >= DMA_MIN_BYTES);
+  IntReadTransaction.completeCallbackFunction = ReadCompleteCallback;
+  IntReadTransaction.completeCallbackArguments = ReadCompleteArguments;
+
+  (void)I2C_Submit(&IntReadTransaction);
+}
 
-  I2C0_C1 |= I2C_C1_RSTA_MASK;          // Generate Repeat START signal
-  I2C0_D = (SlaveAddress << 1) | 0x01;  // Write slave address to data register with R bit
-  WaitForAK();                          // Wait for AK from slave
-  I2C0_C1 &= ~I2C_C1_TX_MASK;           // Enable receive mode
 
-  if (nbBytes == 1)
-  {
-    I2C0_C1 |= I2C_C1_TXAK_MASK;        // When in master receive mode and there is only 1 byte to be received, TXACK should be set before dummy read
-    dummy = I2C0_D;                     // Store second last byte in data register into data
-    WaitForAK();                        // Send AK to slave
-    Stop();                             // Send STOP signal
-    data[nbBytes - 1] = I2C0_D;         // Store last byte in data register in data
-  }
+void __attribute__ ((interrupt)) I2C_ISR(void)
+{
+  uint8_t dummy;
+  TI2CTransaction* transaction = Current;
 
-  else if (nbBytes > 1)
-  {
-    I2C0_C1 &= ~I2C_C1_TXAK_MASK;       // Clear TXAK for AK
-    dummy = I2C0_D;                     // Read from data register to initiate receiving of next byte
-    WaitForAK();                        // Send AK to slave
+  OS_ISREnter();
 
-    // Read each byte, except last 2
-    for (i = 0; i < nbBytes - 2; i++)
-    {
-      data[i] = I2C0_D;                  // Store byte in data register into data
-      WaitForAK();                       // Send AK to slave
-    }
+  I2C0_S |= I2C_S_IICIF_MASK;            // w1c interrupt flag
 
-    I2C0_C1 |= I2C_C1_TXAK_MASK;         // Set TXAK bit to send NAK bit to slave after next read
-    data[nbBytes - 2] = I2C0_D;          // Store second last byte in data register into data
-    WaitForAK();                         // Send AK to slave
-    Stop();                              // Send STOP signal
-    data[nbBytes - 1] = I2C0_D;          // Store last byte in data register in data
+  if (!transaction || WaitingForBus)
+  {
+    OS_ISRExit();
+    return;
   }
 
-  if (ReadCompleteCallback)
+  // Lost the bus to another master, or the slave did not acknowledge what was sent
+  if ((I2C0_S & I2C_S_ARBL_MASK) ||
+      ((Stage != STAGE_READ_DATA) && (I2C0_S & I2C_S_RXAK_MASK)))
   {
-    (*ReadCompleteCallback)(ReadCompleteArguments);
+    I2C0_S |= I2C_S_ARBL_MASK;           // w1c arbitration lost flag
+    Finish(false);
+    OS_ISRExit();
+    return;
   }
-}
 
+  switch (Stage)
+  {
+    case STAGE_SLAVE_ADDRESS:
+      I2C0_D = transaction->registerAddress; // Write register address to data register
+      Stage = STAGE_REGISTER_ADDRESS;
+      break;
 
-void I2C_IntRead(const uint8_t registerAddress, uint8_t* const data, const uint8_t nbBytes)
-{
-  // Follow Figure 11 in MMA8451Q data sheet (Just do address cycling and have first byte ready to read)
-
-  WaitForIdleBus();                     // Wait for stop signal if bus is busy
+    case STAGE_REGISTER_ADDRESS:
+      if (transaction->read)
+      {
+        I2C0_C1 |= I2C_C1_RSTA_MASK;                     // Generate Repeat START signal
+        I2C0_D = (transaction->slaveAddress << 1) | 0x01; // Write slave address to data register with R bit
+        Stage = STAGE_REPEAT_START;
+        break;
+      }
+      Stage = STAGE_WRITE_DATA;
+      // Fall through to send the first byte
 
-  I2C0_C1 &= ~I2C_C1_IICIE_MASK;        // Disable interrupts
+    case STAGE_WRITE_DATA:
+      if (Index < transaction->nbBytes)
+        I2C0_D = transaction->data[Index++];  // Write data to data register
+      else
+        Finish(true);
+      break;
 
-  if (ReadCompleted)
-  {
-    RxNbBytes = nbBytes;                // Store nbBytes in private global variable which keeps track of current byte being read
-    RxData = data;                      // Store data in private global variable
-    ReadCompleted = false;              // False at the start of every I2C_IntRead call
-  }
+    case STAGE_REPEAT_START:
+      I2C0_C1 &= ~I2C_C1_TX_MASK;        // Enable receive mode
 
-  Start();                              // Send START signal
+      if (transaction->nbBytes == 1)
+        I2C0_C1 |= I2C_C1_TXAK_MASK;     // When there is only 1 byte to be received, TXAK should be set before dummy read
 
-  I2C0_D = (SlaveAddress << 1) & 0xFE;  // Write slave address to data register with W bit
-  WaitForAK();                          // Wait for AK from slave
+      if (transaction->useDMA)
+        DMAStart();
 
-  I2C0_D = registerAddress;             // Write register address to data register
-  WaitForAK();                          // Wait for AK from slave
+      dummy = I2C0_D;                    // Read from data register to initiate receiving of first byte
+      (void)dummy;
+      Stage = STAGE_READ_DATA;
+      break;
 
-  I2C0_C1 |= I2C_C1_RSTA_MASK;          // Generate Repeat START signal
-  I2C0_D = (SlaveAddress << 1) | 0x01;  // Write slave address to data register with R bit
-  // Don't WaitForAk, let the IICIF stay set
+    case STAGE_READ_DATA:
+      // Woken both by the end of a DMA burst and by the byte that came in just then
+      if (!(I2C0_S & I2C_S_TCF_MASK))
+        break;
 
-  I2C0_C1 &= ~I2C_C1_TX_MASK;           // Enable receive mode
+      switch (transaction->nbBytes - Index)
+      {
+        case 1:  // Last byte
+          // Stop the bus clocking in more bytes before reading, by giving it up or by keeping it for the next transaction
+          if (QueueHead)
+            I2C0_C1 |= I2C_C1_TX_MASK;
+          else
+            Stop();                      // Send STOP signal
+          transaction->data[Index++] = I2C0_D;
+          Finish(true);
+          break;
+
+        case 2:  // Second last byte
+          I2C0_C1 |= I2C_C1_TXAK_MASK;   // Set TXAK bit to send NAK bit to slave after next read
+          transaction->data[Index++] = I2C0_D;
+          break;
+
+        default: // Not last or second last byte
+          transaction->data[Index++] = I2C0_D;
+          break;
+      }
+      break;
+  }
 
-  I2C0_C1 |= I2C_C1_IICIE_MASK;         // Enable interrupts
+  OS_ISRExit();
 }
 
 
-void __attribute__ ((interrupt)) I2C_ISR(void)
+void __attribute__ ((interrupt)) I2C_DMAISR(void)
 {
   OS_ISREnter();
 
-  I2C0_S |= I2C_S_IICIF_MASK;          // w1c interrupt flag
+  DMA_CINT = DMA_CINT_CINT(DMA_CHANNEL); // Clear the DMA interrupt flag
 
-  if (I2C0_S & I2C_S_TCF_MASK)         // Check the transfer complete flag
-  {
-    OS_SemaphoreSignal(CallCallback);  // Signal the I2C_RxThread
-    OS_ISRExit();
-  }
-  else
-  {
-    OS_ISRExit();
-  }
+  // The last 2 bytes need the NAK and STOP, so the I2C interrupt takes over
+  I2C0_C1 &= ~I2C_C1_DMAEN_MASK;
+  I2C0_S |= I2C_S_IICIF_MASK;            // w1c the flag left by the bytes the DMA took
+  I2C0_C1 |= I2C_C1_IICIE_MASK;
+
+  // The byte after the burst normally interrupts when it comes in, unless it came in before its flag was cleared
+  if (I2C0_S & I2C_S_TCF_MASK)
+    NVICISPR0 = (1 << 24);               // Set the I2C0 interrupt pending
+
+  OS_ISRExit();
 }
 
 
@@ -332,42 +556,48 @@ void __attribute__ ((interrupt)) I2C_ISR(void)
 
 void I2C_RxThread(void* pData)
 {
-  uint8_t dummy;
+  TI2CTransaction* transaction;
+  bool waiting;
+
   for (;;)
   {
     OS_SemaphoreWait(CallCallback, 0);
 
-    static uint8_t localCount = 0;
-
-    switch (RxNbBytes)
+    for (;;)
     {
-      case 2:  // Second last byte
-        I2C0_C1 |= I2C_C1_TXAK_MASK;
-        RxNbBytes--;
-        RxData[localCount] = I2C0_D;
-        localCount++;
-        break;
+      EnterCritical();
+      transaction = DoneHead;
+      if (transaction)
+      {
+        DoneHead = transaction->next;
+        if (!DoneHead)
+          DoneTail = NULL;
+        transaction->busy = false;       // The client may submit it again from its callback
+      }
+      ExitCritical();
 
-      case 1:  // Last byte
-        Stop();
-        RxNbBytes--;
-        RxData[localCount] = I2C0_D;
-        localCount++;
+      if (!transaction)
         break;
 
-      case 0:  // Read completed
-        localCount = 0;
-        ReadCompleted = true;
-        if (ReadCompleteCallback)
-        {
-          (*ReadCompleteCallback)(ReadCompleteArguments);
-        }
+      if (transaction->completeCallbackFunction)
+      {
+        (*transaction->completeCallbackFunction)(transaction->completeCallbackArguments);
+      }
+    }
+
+    // Start a transaction held up by a busy bus, checking again every tick instead of spinning
+    for (;;)
+    {
+      EnterCritical();
+      if (WaitingForBus)
+        Begin(false);
+      waiting = WaitingForBus;
+      ExitCritical();
+
+      if (!waiting)
         break;
 
-      default:  // Not last or second last byte
-        RxNbBytes--;
-        RxData[localCount] = I2C0_D;
-        localCount++;
+      OS_TimeDelay(1);
     }
   }
 }
@@ -22,6 +22,24 @@ typedef struct
   void* readCompleteCallbackArguments;          /*!< The user's read complete callback function arguments. */
 } TI2CModule;
 
+/*!
+ * @struct TI2CTransaction
+ */
+typedef struct I2CTransaction
+{
+  uint8_t slaveAddress;                     /*!< The slave device address. */
+  uint8_t registerAddress;                  /*!< The first register to read or write. */
+  bool read;                                /*!< TRUE to read from the device, FALSE to write to it. */
+  uint8_t* data;                            /*!< The bytes to write, or where to store the bytes that are read. */
+  uint8_t nbBytes;                          /*!< The number of bytes to read or write. */
+  bool useDMA;                              /*!< TRUE to receive all but the last 2 bytes with eDMA, for reads of 3 bytes or more. */
+  void (*completeCallbackFunction)(void*);  /*!< The user's complete callback function. */
+  void* completeCallbackArguments;          /*!< The user's complete callback function arguments. */
+  volatile bool busy;                       /*!< Set by the I2C module from I2C_Submit until just before the callback. */
+  volatile bool succeeded;                  /*!< Set by the I2C module, FALSE if the device did not acknowledge. */
+  struct I2CTransaction* next;              /*!< Used by the I2C module to queue transactions. */
+} TI2CTransaction;
+
 /*! @brief Sets up the I2C before first use.
  *
  *  @param aI2CModule is a structure containing the operating conditions for the module.
@@ -30,7 +48,17 @@ typedef struct
  */
 bool I2C_Init(const TI2CModule* const aI2CModule, const uint32_t moduleClk);
 
-/*! @brief Selects the current slave device
+/*! @brief Queues a transaction to run on the bus.
+ *
+ * Transactions run in the order they are submitted, each one following on from the last with a repeat START,
+ * so any number of devices can share the bus. The complete callback function is called from I2C_RxThread.
+ * A read takes 3 interrupts to address the register and 1 per byte, with useDMA set it takes 6 however long it is.
+ * @param transaction The transaction, which must not be changed until its callback has been called.
+ * @return bool - TRUE if the transaction was queued, FALSE if it is already queued or is not valid.
+ */
+bool I2C_Submit(TI2CTransaction* const transaction);
+
+/*! @brief Selects the slave device used by I2C_Write, I2C_PollRead and I2C_IntRead
  *
  * @param slaveAddress The slave device address.
  */
@@ -38,38 +66,52 @@ void I2C_SelectSlaveDevice(const uint8_t slaveAddress);
 
 /*! @brief Write a byte of data to a specified register
  *
+ * The I2C interrupt sends the data, the calling thread sleeps until it has been sent.
  * @param registerAddress The register address.
  * @param data The 8-bit data to write.
+ * @note Must be called from a thread, with interrupts enabled.
  */
 void I2C_Write(const uint8_t registerAddress, const uint8_t data);
 
 /*! @brief Reads data of a specified length starting from a specified register
  *
- * Uses polling as the method of data reception.
+ * The I2C interrupt receives the data, with eDMA for reads of 3 bytes or more, the calling thread sleeps
+ * until the read is complete and then calls the read complete callback function.
  * @param registerAddress The register address.
  * @param data A pointer to store the bytes that are read.
  * @param nbBytes The number of bytes to read.
+ * @note Must be called from a thread, with interrupts enabled.
  */
 void I2C_PollRead(const uint8_t registerAddress, uint8_t* const data, const uint8_t nbBytes);
 
 /*! @brief Reads data of a specified length starting from a specified register
  *
- * Uses interrupts as the method of data reception.
+ * Uses interrupts as the method of data reception, with eDMA for reads of 3 bytes or more, and returns as soon as the read has been queued.
+ * I2C_RxThread calls the read complete callback function once the data is in.
  * @param registerAddress The register address.
- * @param data A pointer to store the bytes that are read.
+ * @param data A pointer to store the bytes that are read, which must stay valid until the read is complete.
  * @param nbBytes The number of bytes to read.
+ * @note The read is dropped if the last one has not completed yet.
  */
 void I2C_IntRead(const uint8_t registerAddress, uint8_t* const data, const uint8_t nbBytes);
 
 /*! @brief Interrupt service routine for the I2C.
  *
- *  Only used for reading data.
- *  At the end of reception, the user callback function will be called.
+ *  Runs each stage of the current transaction, then starts the next one in the queue.
+ *  At the end of each transaction, I2C_RxThread is signalled.
  *  @note Assumes the I2C module has been initialized.
  */
 void __attribute__ ((interrupt)) I2C_ISR(void);
 
-/*! @brief Reads data from the accelerometer.
+/*! @brief Interrupt service routine for the eDMA channel used by the I2C.
+ *
+ *  A receive burst has finished, the I2C interrupt takes over to receive the last 2 bytes.
+ *  @note Assumes the I2C module has been initialized.
+ */
+void __attribute__ ((interrupt)) I2C_DMAISR(void);
+
+/*! @brief Calls the complete callback function of each transaction that has finished,
+ *         and starts a transaction that found the bus busy once it is free.
  */
 void I2C_RxThread(void* pData);
 
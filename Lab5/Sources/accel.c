@@ -253,13 +253,11 @@ bool Accel_Init(const TAccelSetup* const accelSetup)
 
   // Sampling rate when asleep -- leave as default of 50Hz
 
-  // Put settings onto the register(s)
-  OS_DisableInterrupts();
+  // Put settings onto the register(s), the I2C interrupt has to run so interrupts stay enabled
   ActivateAccelerometer(false);
   I2C_Write(ADDRESS_CTRL_REG1, CTRL_REG1);
   I2C_Write(ADDRESS_CTRL_REG5, CTRL_REG5);
   ActivateAccelerometer(true);
-  OS_EnableInterrupts();
 
   // Set arm bit for PortB interrupts -- Flag and interrupt on falling edge.
   PORTB_PCR4 |= PORT_PCR_IRQC(0b1010);
@@ -300,11 +298,9 @@ void Accel_SetMode(const TAccelMode mode)
       // Clear the interrupt bit in case modes are switched intra-program
       CTRL_REG4_INT_EN_DRDY = 0;
 
-      OS_DisableInterrupts();
       ActivateAccelerometer(false);
       I2C_Write(ADDRESS_CTRL_REG4, CTRL_REG4);
       ActivateAccelerometer(true);
-      OS_EnableInterrupts();
       break;
 
     case (ACCEL_INT):
@@ -312,11 +308,9 @@ void Accel_SetMode(const TAccelMode mode)
       // Set 'data ready' interrupt for Accelerometer
       CTRL_REG4_INT_EN_DRDY = 1;
 
-      OS_DisableInterrupts();
       ActivateAccelerometer(false);
       I2C_Write(ADDRESS_CTRL_REG4, CTRL_REG4);
       ActivateAccelerometer(true);
-      OS_EnableInterrupts();
       break;
   }
 }
@@ -109,7 +109,7 @@
     (tIsrFunc)&Cpu_ivINT_DMA15_DMA31,  /* 0x1F  0x0000007C   -   ivINT_DMA15_DMA31              unused by PE */
     (tIsrFunc)&Cpu_ivINT_DMA_Error,    /* 0x20  0x00000080   -   ivINT_DMA_Error                unused by PE */
     (tIsrFunc)&Cpu_ivINT_MCM,          /* 0x21  0x00000084   -   ivINT_MCM                      unused by PE */
-    (tIsrFunc)&Cpu_ivINT_FTFE,         /* 0x22  0x00000088   -   ivINT_FTFE                     unused by PE */
+    (tIsrFunc)&FTFE_ISR,               /* 0x22  0x00000088   -   ivINT_FTFE                     unused by PE */
     (tIsrFunc)&Cpu_ivINT_Read_Collision, /* 0x23  0x0000008C   -   ivINT_Read_Collision           unused by PE */
     (tIsrFunc)&Cpu_ivINT_LVD_LVW,      /* 0x24  0x00000090   -   ivINT_LVD_LVW                  unused by PE */
     (tIsrFunc)&Cpu_ivINT_LLW,          /* 0x25  0x00000094   -   ivINT_LLW                      unused by PE */
@@ -157,12 +157,12 @@
     (tIsrFunc)&Cpu_ivINT_FTM1,         /* 0x4F  0x0000013C   -   ivINT_FTM1                     unused by PE */
     (tIsrFunc)&Cpu_ivINT_FTM2,         /* 0x50  0x00000140   -   ivINT_FTM2                     unused by PE */
     (tIsrFunc)&Cpu_ivINT_CMT,          /* 0x51  0x00000144   -   ivINT_CMT                      unused by PE */
-    (tIsrFunc)&Cpu_ivINT_RTC,          /* 0x52  0x00000148   -   ivINT_RTC                      unused by PE */
+    (tIsrFunc)&RTC_AlarmISR,           /* 0x52  0x00000148   -   ivINT_RTC                      unused by PE */
     (tIsrFunc)&RTC_ISR,                /* 0x53  0x0000014C   -   ivINT_RTC_Seconds              unused by PE */
     (tIsrFunc)&PIT0_ISR,               /* 0x54  0x00000150   -   ivINT_PIT0                     unused by PE */
     (tIsrFunc)&PIT1_ISR,               /* 0x55  0x00000154   -   ivINT_PIT1                     unused by PE */
-    (tIsrFunc)&Cpu_ivINT_PIT2,       /* 0x56  0x00000158   -   ivINT_PIT2                     unused by PE */
-    (tIsrFunc)&Cpu_ivINT_PIT3,       /* 0x57  0x0000015C   -   ivINT_PIT3                     unused by PE */
+    (tIsrFunc)&PIT2_ISR,               /* 0x56  0x00000158   -   ivINT_PIT2                     unused by PE */
+    (tIsrFunc)&PIT3_ISR,               /* 0x57  0x0000015C   -   ivINT_PIT3                     unused by PE */
    (tIsrFunc)&Cpu_ivINT_PDB0,          /* 0x58  0x00000160   -   ivINT_PDB0                     unused by PE */
     (tIsrFunc)&Cpu_ivINT_USB0,         /* 0x59  0x00000164   -   ivINT_USB0                     unused by PE */
     (tIsrFunc)&Cpu_ivINT_USBDCD,       /* 0x5A  0x00000168   -   ivINT_USBDCD                   unused by PE */
@@ -0,0 +1,264 @@
+/*! @file
+ *
+ *  @brief Runs the Flash modules against the simulated FTFE and reports wear and time.
+ *
+ *  Each scenario drives one user of Flash the way the tower does, then waits for the background threads
+ *  to finish committing. The exit status is non-zero if any write failed or read back wrong.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+/*!
+**  @addtogroup FlashBench_module FlashBench module documentation
+**  @{
+*/
+/* MODULE FlashBench */
+
+#include <stdio.h>
+#include "brOS.h"
+
+// Time given to the background threads to commit after each scenario, in OS ticks
+#define SETTLE_TICKS 2000
+
+#define NB_TAPS          5000
+#define NB_CONFIG_WRITES 100
+#define NB_EVENTS        4000
+#define EVENT_BURST      8
+#define NB_DATA_WRITES   200
+
+// Programmed into the scratch sector, then programmed over with fewer bits set
+#define FIRST_PHRASE  0xFFFF0000FFFF0000ull
+#define SECOND_PHRASE 0x0000000000000000ull
+
+typedef struct
+{
+  const char* name;
+  uint32_t start;
+  uint32_t nbSectors;
+} TRegion;
+
+static const TRegion Regions[] =
+{
+  {"Data",     FLASH_DATA_START,     1},
+  {"Counter",  FLASH_COUNTER_START,  FLASH_COUNTER_NB_SECTORS},
+  {"Config",   FLASH_CONFIG_START,   FLASH_CONFIG_NB_SECTORS},
+  {"EventLog", FLASH_EVENTLOG_START, FLASH_EVENTLOG_NB_SECTORS},
+  {"Scratch",  FLASH_SCRATCH_START,  1}
+};
+
+static uint32_t NbFailures;
+
+// Slowest commands over every scenario, since each scenario resets the Flash statistics
+static uint32_t MaxEraseCycles, MaxProgramCycles;
+
+OS_THREAD_STACK (BenchThreadStack, THREAD_STACK_SIZE);
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Records a failed check.
+ *
+ *  @param success The result of the check.
+ *  @param what What was being checked.
+ */
+static void Check(const bool success, const char* const what)
+{
+  if (!success)
+  {
+    printf("FAIL: %s\n", what);
+    NbFailures++;
+  }
+}
+
+/*! @brief Counts taps, one every 10 ms.
+ */
+static void CounterScenario(void)
+{
+  for (uint32_t i = 0; i < NB_TAPS; i++)
+  {
+    Counter_Increment((i % 2) ? COUNTER_LOWERS : COUNTER_RAISES);
+    OS_TimeDelay(10);
+  }
+
+  OS_TimeDelay(SETTLE_TICKS);
+  Check(Counter_Get(COUNTER_RAISES) == NB_TAPS / 2, "raise count");
+  Check(Counter_Get(COUNTER_LOWERS) == NB_TAPS / 2, "lower count");
+}
+
+/*! @brief Changes the tower mode back and forth.
+ */
+static void ConfigScenario(void)
+{
+  for (uint32_t i = 0; i < NB_CONFIG_WRITES; i++)
+  {
+    Check(Config_Set(CONFIG_TOWER_MODE, 1 + (i % 2)), "config write");
+    OS_TimeDelay(100);
+  }
+
+  Check(Config_Get(CONFIG_TOWER_MODE) == 1 + ((NB_CONFIG_WRITES - 1) % 2), "config read back");
+}
+
+/*! @brief Posts events in bursts, as an alarm sequence does.
+ */
+static void EventLogScenario(void)
+{
+  for (uint32_t i = 0; i < NB_EVENTS; i++)
+  {
+    EventLog_Post(EVENT_ALARM_SET + (i % 4), (uint8_t)i);
+    if ((i % EVENT_BURST) == EVENT_BURST - 1)
+      OS_TimeDelay(50);
+  }
+
+  OS_TimeDelay(SETTLE_TICKS);
+  Check(EventLog_NbDropped() == 0, "no events dropped");
+}
+
+/*! @brief Writes a variable in the data block and waits for it to reach Flash each time.
+ */
+static void DataScenario(void)
+{
+  volatile uint16_t* variable;
+
+  Check(Flash_AllocateVar((volatile void**)&variable, sizeof(*variable)), "allocate");
+
+  for (uint32_t i = 0; i < NB_DATA_WRITES; i++)
+  {
+    Check(Flash_Write16(variable, (uint16_t)(1000 + i)) && Flash_Sync(), "data write");
+    OS_TimeDelay(100);
+  }
+
+  Check(_FH(FLASH_DATA_START) == (uint16_t)(1000 + NB_DATA_WRITES - 1), "data read back");
+}
+
+/*! @brief Programs a phrase twice without an erase, which both Flash and the FTFE must refuse.
+ */
+static void ReprogramScenario(void)
+{
+  TFlashCommand command = {FLASH_CMD_PROGRAM_PHRASE, FLASH_SCRATCH_START, SECOND_PHRASE};
+  TFlashSimStats before, after;
+
+  Check(Flash_EraseSector(FLASH_SCRATCH_START) && Flash_ProgramPhrase(FLASH_SCRATCH_START, FIRST_PHRASE), "first program");
+  Check(!Flash_ProgramPhrase(FLASH_SCRATCH_START, SECOND_PHRASE), "second program refused");
+
+  // Go around Flash_ProgramPhrase, the FTFE must fail the command itself
+  FlashSim_GetStats(&before);
+  Check(Flash_Submit(&command), "second program submitted");
+  while (!command.complete)
+    OS_TimeDelay(1);
+  FlashSim_GetStats(&after);
+
+  Check(!command.success && (after.NbReprograms == before.NbReprograms + 1), "second program caught");
+  Check(_FP(FLASH_SCRATCH_START) == FIRST_PHRASE, "first program kept");
+
+  // Flash_Benchmark expects the scratch sector erased
+  Check(Flash_EraseSector(FLASH_SCRATCH_START), "scratch erase");
+}
+
+/*! @brief Runs a scenario and prints what it cost.
+ *
+ *  @param name The name of the scenario.
+ *  @param scenario The scenario.
+ */
+static void Run(const char* const name, void (*scenario)(void))
+{
+  TFlashSimStats before, after;
+  TFlashStats flashStats;
+  uint64_t start = FlashSim_Now();
+
+  FlashSim_GetStats(&before);
+  Flash_ResetStats();
+  scenario();
+  OS_TimeDelay(SETTLE_TICKS);
+  FlashSim_GetStats(&after);
+  Flash_GetStats(&flashStats);
+
+  if (flashStats.MaxEraseCycles > MaxEraseCycles)
+    MaxEraseCycles = flashStats.MaxEraseCycles;
+  if (flashStats.MaxProgramCycles > MaxProgramCycles)
+    MaxProgramCycles = flashStats.MaxProgramCycles;
+
+  printf("%-10s %8u %8u %10u %10.1f %12.1f\n", name,
+         after.NbErases - before.NbErases,
+         flashStats.NbErasesSaved,
+         after.NbPhrasesProgrammed - before.NbPhrasesProgrammed,
+         (after.BusyCycles - before.BusyCycles) * 1000.0 / CPU_CORE_CLK_HZ,
+         (FlashSim_Now() - start) * 1000.0 / CPU_CORE_CLK_HZ);
+}
+
+/*! @brief Prints the erases of each region, total and for its most worn sector.
+ */
+static void PrintWear(void)
+{
+  printf("\n%-10s %8s %12s %12s\n", "Region", "Sectors", "Erases", "Max/sector");
+
+  for (uint8_t r = 0; r < sizeof(Regions) / sizeof(Regions[0]); r++)
+  {
+    uint32_t total = 0, most = 0;
+
+    for (uint32_t s = 0; s < Regions[r].nbSectors; s++)
+    {
+      uint32_t erases = FlashSim_SectorErases(Regions[r].start + s*FLASH_SECTOR_SIZE);
+
+      total += erases;
+      if (erases > most)
+        most = erases;
+    }
+
+    printf("%-10s %8u %12u %12u\n", Regions[r].name, Regions[r].nbSectors, total, most);
+  }
+}
+
+// THREADS
+
+/*! @brief Initializes the modules and runs every scenario.
+ *
+ *  @param pData is not used but is required by the OS to create a thread.
+ */
+static void BenchThread(void* pData)
+{
+  uint32_t phraseRate = 0, sectionRate = 0;
+  TFlashSimStats stats;
+
+  Check(Flash_Init() && Counter_Init() && Config_Init() && EventLog_Init(), "init");
+
+  printf("%-10s %8s %8s %10s %10s %12s\n", "Scenario", "Erases", "Saved", "Phrases", "Busy (ms)", "Elapsed (ms)");
+  Run("Counter", CounterScenario);
+  Run("Config", ConfigScenario);
+  Run("EventLog", EventLogScenario);
+  Run("Data", DataScenario);
+  Run("Reprogram", ReprogramScenario);
+
+  Check(Flash_Benchmark(&phraseRate, &sectionRate), "benchmark");
+  printf("\nProgram Phrase  %8u bytes/s\nProgram Section %8u bytes/s\n", phraseRate, sectionRate);
+
+  PrintWear();
+
+  FlashSim_GetStats(&stats);
+  printf("\nCommands %u, errors %u, programs of a phrase not erased %u\n", stats.NbCommands, stats.NbErrors, stats.NbReprograms);
+  printf("Slowest erase %.2f ms, slowest phrase program %.1f us\n",
+         MaxEraseCycles * 1000.0 / CPU_CORE_CLK_HZ, MaxProgramCycles * 1e6 / CPU_CORE_CLK_HZ);
+
+  // The only program of a phrase that was not erased should be the one ReprogramScenario makes on purpose
+  Check(stats.NbReprograms == 1, "FTFE rules kept");
+
+  OS_ThreadDelete(OS_PRIORITY_SELF);
+}
+
+int main(void)
+{
+  if (!FlashSim_Init())
+  {
+    printf("FAIL: could not map the simulated Flash\n");
+    return 1;
+  }
+
+  OS_Init(CPU_CORE_CLK_HZ, false);
+  (void)OS_ThreadCreate(BenchThread, NULL, &BenchThreadStack[THREAD_STACK_SIZE - 1], INIT_MODULES_PRIORITY);
+  OS_Start();
+
+  printf("\n%s\n", NbFailures ? "FAILED" : "PASSED");
+  return NbFailures ? 1 : 0;
+}
+
+/*!
+** @}
+*/
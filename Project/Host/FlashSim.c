@@ -0,0 +1,247 @@
+/*! @file
+ *
+ *  @brief A simulated FTFE and program Flash block 1, for running the Flash modules on a PC.
+ *
+ *  Flash block 1 and the FlexRAM are mapped at the tower's addresses, so the _FP reads in the modules work
+ *  unchanged. Commands follow the FTFE rules: an erase sets a whole sector to 1s, a program must be phrase
+ *  aligned and the phrase must be erased, since it cannot be programmed twice between erases. A program of a
+ *  phrase that is not erased fails with MGSTAT0 and is left undone. Each command takes its typical time on a simulated clock, which
+ *  also drives DWT_CYCCNT.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+/*!
+**  @addtogroup FlashSim_module FlashSim module documentation
+**  @{
+*/
+/* MODULE FlashSim */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <sys/mman.h>
+#include "brOS.h"
+
+// FCCOB0 once the FTFE has taken a command, so that a stale command is never launched twice
+#define NO_COMMAND 0xFF
+
+// Core clock cycles taken by each read of FSTAT while a command is in progress, so busy-waits end
+#define POLL_CYCLES 8
+
+#define NB_SECTORS (FLASHSIM_SIZE / FLASH_SECTOR_SIZE)
+
+// Registers
+volatile uint8_t  FlashSimFCNFG = FTFE_FCNFG_RAMRDY_MASK;
+volatile uint8_t  FlashSimFCCOB[12] = {NO_COMMAND};
+volatile uint32_t FlashSimCycles;
+volatile uint32_t FlashSimDEMCR;
+volatile uint32_t FlashSimDWTCTRL;
+volatile uint32_t FlashSimNVIC;
+
+static volatile uint8_t FSTAT;                      // What the code reads and writes
+static uint8_t Status = FTFE_FSTAT_CCIF_MASK;      // The real state of FSTAT
+
+// Command in progress
+static bool     Busy;
+static uint64_t DoneAt;
+static uint8_t  Result;
+
+static uint64_t Now;
+static uint32_t Erases[NB_SECTORS];
+static TFlashSimStats Stats;
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Programs one erased phrase.
+ *
+ *  @param offset The offset of the phrase in the simulated Flash.
+ *  @param phrase The value being programmed.
+ */
+static void Program(const uint32_t offset, const uint64_t phrase)
+{
+  uint64_t current = _FP(FLASHSIM_START + offset);
+
+  // NOR Flash cannot set a bit, and a second program would over-stress the cells even if it only took bits
+  // from 1 to 0, so the verify after the program fails
+  if (current != ~(uint64_t)0)
+  {
+    Stats.NbReprograms++;
+    Result |= FTFE_FSTAT_MGSTAT0_MASK;
+    return;
+  }
+
+  _FP(FLASHSIM_START + offset) = phrase;
+  Stats.NbPhrasesProgrammed++;
+}
+
+/*! @brief Carries out the command loaded in FCCOB and starts timing it.
+ */
+static void Launch(void)
+{
+  uint8_t  command = FlashSimFCCOB[0];
+  uint32_t address = ((uint32_t)FlashSimFCCOB[1] << 16) | ((uint32_t)FlashSimFCCOB[2] << 8) | FlashSimFCCOB[3];
+  uint32_t offset  = address - FLASHSIM_START;
+  uint64_t phrase  = 0;
+  uint64_t cycles  = FLASHSIM_COMMAND_CYCLES;
+
+  for (uint8_t i = 4; i < 12; i++)
+    phrase = (phrase << 8) | FlashSimFCCOB[i];
+
+  FlashSimFCCOB[0] = NO_COMMAND;
+  Status &= ~(FTFE_FSTAT_CCIF_MASK | FTFE_FSTAT_ACCERR_MASK | FTFE_FSTAT_FPVIOL_MASK | FTFE_FSTAT_MGSTAT0_MASK);
+  Result = 0;
+  Stats.NbCommands++;
+
+  // Only block 1 is simulated
+  if ((address < FLASHSIM_START) || (offset >= FLASHSIM_SIZE))
+  {
+    Result = FTFE_FSTAT_ACCERR_MASK;
+  }
+  else
+  {
+    switch (command)
+    {
+      case FLASH_CMD_PROGRAM_PHRASE:
+        if (offset % FLASH_PHRASE_SIZE)
+        {
+          Result = FTFE_FSTAT_ACCERR_MASK;
+          break;
+        }
+        Program(offset, phrase);
+        cycles += FLASHSIM_PHRASE_CYCLES;
+        break;
+
+      case FLASH_CMD_ERASE_SECTOR:
+        if (offset % FLASH_SECTOR_SIZE)
+        {
+          Result = FTFE_FSTAT_ACCERR_MASK;
+          break;
+        }
+        memset((void*)(FLASHSIM_START + offset), 0xFF, FLASH_SECTOR_SIZE);
+        Erases[offset / FLASH_SECTOR_SIZE]++;
+        Stats.NbErases++;
+        cycles += FLASHSIM_ERASE_CYCLES;
+        break;
+
+      case FLASH_CMD_PROGRAM_SECTION:
+      {
+        // The number of phrases is in FCCOB4 (high byte) and FCCOB5
+        uint16_t nbPhrases = ((uint16_t)FlashSimFCCOB[4] << 8) | FlashSimFCCOB[5];
+
+        if ((offset % FLASH_PHRASE_SIZE) || !nbPhrases || !(FlashSimFCNFG & FTFE_FCNFG_RAMRDY_MASK) ||
+            (nbPhrases*FLASH_PHRASE_SIZE > FLASHSIM_FLEXRAM_SIZE) || (offset + nbPhrases*FLASH_PHRASE_SIZE > FLASHSIM_SIZE))
+        {
+          Result = FTFE_FSTAT_ACCERR_MASK;
+          break;
+        }
+        for (uint16_t i = 0; i < nbPhrases; i++)
+          Program(offset + i*FLASH_PHRASE_SIZE, _FP(FLASHSIM_FLEXRAM + i*FLASH_PHRASE_SIZE));
+        cycles += (uint64_t)nbPhrases * FLASHSIM_SECTION_CYCLES;
+        break;
+      }
+
+      default:
+        Result = FTFE_FSTAT_ACCERR_MASK;
+        break;
+    }
+  }
+
+  if (Result)
+    Stats.NbErrors++;
+
+  Busy = true;
+  DoneAt = Now + cycles;
+  Stats.BusyCycles += cycles;
+}
+
+/*! @brief Carries out a launch written to FSTAT since it was last accessed.
+ */
+static void Service(void)
+{
+  if ((FSTAT & FTFE_FSTAT_CCIF_MASK) && (FlashSimFCCOB[0] != NO_COMMAND) && !Busy)
+    Launch();
+
+  FSTAT = Status;
+}
+
+// PUBLIC FUNCTIONS
+
+bool FlashSim_Init(void)
+{
+  void* flash   = mmap((void*)FLASHSIM_START, FLASHSIM_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  void* flexRAM = mmap((void*)FLASHSIM_FLEXRAM, FLASHSIM_FLEXRAM_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+  if ((flash != (void*)FLASHSIM_START) || (flexRAM != (void*)FLASHSIM_FLEXRAM))
+    return false;
+
+  // A new part comes erased
+  memset(flash, 0xFF, FLASHSIM_SIZE);
+  FSTAT = Status;
+  return true;
+}
+
+volatile uint8_t* FlashSim_FSTAT(void)
+{
+  Service();
+
+  if (Busy)
+    FlashSim_Advance(POLL_CYCLES);
+
+  return &FSTAT;
+}
+
+uint64_t FlashSim_Now(void)
+{
+  return Now;
+}
+
+void FlashSim_Advance(const uint64_t cycles)
+{
+  Service();
+
+  Now += cycles;
+  FlashSimCycles += (uint32_t)cycles;
+
+  if (Busy && (Now >= DoneAt))
+  {
+    Busy = false;
+    Status |= FTFE_FSTAT_CCIF_MASK | Result;
+    FSTAT = Status;
+  }
+}
+
+bool FlashSim_Busy(uint64_t* const when)
+{
+  Service();
+
+  *when = DoneAt;
+  return Busy;
+}
+
+bool FlashSim_InterruptPending(void)
+{
+  Service();
+
+  return (Status & FTFE_FSTAT_CCIF_MASK) && (FlashSimFCNFG & FTFE_FCNFG_CCIE_MASK);
+}
+
+uint32_t FlashSim_SectorErases(const uint32_t address)
+{
+  uint32_t offset = address - FLASHSIM_START;
+
+  if ((address < FLASHSIM_START) || (offset >= FLASHSIM_SIZE))
+    return 0;
+
+  return Erases[offset / FLASH_SECTOR_SIZE];
+}
+
+void FlashSim_GetStats(TFlashSimStats* const stats)
+{
+  *stats = Stats;
+}
+
+/*!
+** @}
+*/
@@ -0,0 +1,137 @@
+/*! @file
+ *
+ *  @brief A simulated FTFE and program Flash block 1, for running the Flash modules on a PC.
+ *
+ *  This contains the register stand-ins used by Flash.c and the functions that let the host OS
+ *  advance time, take the command complete interrupt and read back wear statistics.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+
+#ifndef FLASHSIM_H
+#define FLASHSIM_H
+
+// new types
+#include "types.h"
+
+// Core clock of the tower, the simulated cycle counter runs at this rate
+#define CPU_CORE_CLK_HZ 20971520u
+
+// Simulated Flash, mapped at the same addresses as on the tower
+#define FLASHSIM_START       0x00080000LU
+#define FLASHSIM_SIZE        0x00080000LU
+#define FLASHSIM_FLEXRAM     0x14000000LU
+#define FLASHSIM_FLEXRAM_SIZE 0x4000LU
+
+// Typical FTFE timings from the K70 data sheet, in core clock cycles
+#define FLASHSIM_ERASE_CYCLES        (CPU_CORE_CLK_HZ / 1000 * 14)     // 14 ms per sector
+#define FLASHSIM_PHRASE_CYCLES       (CPU_CORE_CLK_HZ / 1000000 * 65)  // 65 us per Program Phrase
+#define FLASHSIM_SECTION_CYCLES      (CPU_CORE_CLK_HZ / 1000000 * 40)  // 40 us per phrase of a Program Section
+#define FLASHSIM_COMMAND_CYCLES      (CPU_CORE_CLK_HZ / 1000000 * 10)  // 10 us to start any command
+
+// FTFE registers
+extern volatile uint8_t FlashSimFCNFG;
+extern volatile uint8_t FlashSimFCCOB[12];
+
+/*! @brief Gets the FSTAT register, after carrying out anything written to it since the last access.
+ *
+ *  FSTAT is write 1 to clear, which a plain variable cannot model. A write of CCIF with a command loaded
+ *  launches the command, and clears ACCERR and FPVIOL.
+ *  @return volatile uint8_t* - A pointer to FSTAT.
+ */
+volatile uint8_t* FlashSim_FSTAT(void);
+
+#define FTFE_FSTAT  (*FlashSim_FSTAT())
+#define FTFE_FCNFG  FlashSimFCNFG
+#define FTFE_FCCOB0 FlashSimFCCOB[0]
+#define FTFE_FCCOB1 FlashSimFCCOB[1]
+#define FTFE_FCCOB2 FlashSimFCCOB[2]
+#define FTFE_FCCOB3 FlashSimFCCOB[3]
+#define FTFE_FCCOB4 FlashSimFCCOB[4]
+#define FTFE_FCCOB5 FlashSimFCCOB[5]
+#define FTFE_FCCOB6 FlashSimFCCOB[6]
+#define FTFE_FCCOB7 FlashSimFCCOB[7]
+#define FTFE_FCCOB8 FlashSimFCCOB[8]
+#define FTFE_FCCOB9 FlashSimFCCOB[9]
+#define FTFE_FCCOBA FlashSimFCCOB[10]
+#define FTFE_FCCOBB FlashSimFCCOB[11]
+
+#define FTFE_FSTAT_MGSTAT0_MASK  0x1u
+#define FTFE_FSTAT_FPVIOL_MASK   0x10u
+#define FTFE_FSTAT_ACCERR_MASK   0x20u
+#define FTFE_FSTAT_RDCOLERR_MASK 0x40u
+#define FTFE_FSTAT_CCIF_MASK     0x80u
+#define FTFE_FCNFG_RAMRDY_MASK   0x2u
+#define FTFE_FCNFG_CCIE_MASK     0x80u
+
+// Core registers used to time commands
+extern volatile uint32_t FlashSimCycles;
+extern volatile uint32_t FlashSimDEMCR;
+extern volatile uint32_t FlashSimDWTCTRL;
+extern volatile uint32_t FlashSimNVIC;
+
+#define DWT_CYCCNT FlashSimCycles
+#define DEMCR      FlashSimDEMCR
+#define DWT_CTRL   FlashSimDWTCTRL
+#define NVICICPR0  FlashSimNVIC
+#define NVICISER0  FlashSimNVIC
+
+/*!
+ * @struct TFlashSimStats
+ */
+typedef struct
+{
+  uint32_t NbErases;            /*!< Sector erases */
+  uint32_t NbPhrasesProgrammed; /*!< Phrases programmed, by Program Phrase or Program Section */
+  uint32_t NbCommands;          /*!< Commands launched */
+  uint32_t NbErrors;            /*!< Commands that ended with ACCERR or MGSTAT0 */
+  uint32_t NbReprograms;        /*!< Programs of a phrase that had not been erased since it was last programmed */
+  uint64_t BusyCycles;          /*!< Core clock cycles the FTFE spent executing commands */
+} TFlashSimStats;
+
+/*! @brief Maps the simulated Flash and FlexRAM and erases the Flash.
+ *
+ *  @return bool - TRUE if the memory was mapped at the tower's addresses.
+ */
+bool FlashSim_Init(void);
+
+/*! @brief Gets the simulated time.
+ *
+ *  @return uint64_t - Core clock cycles since the simulation started.
+ */
+uint64_t FlashSim_Now(void);
+
+/*! @brief Moves the simulated time forward, completing the command in progress when its time comes.
+ *
+ *  @param cycles The number of core clock cycles to advance by.
+ */
+void FlashSim_Advance(const uint64_t cycles);
+
+/*! @brief Gets the time the command in progress completes.
+ *
+ *  @param when Where the completion time, in core clock cycles, is to be written.
+ *  @return bool - TRUE if a command is in progress.
+ */
+bool FlashSim_Busy(uint64_t* const when);
+
+/*! @brief Checks whether the command complete interrupt is being requested.
+ *
+ *  @return bool - TRUE if CCIF and CCIE are both set.
+ */
+bool FlashSim_InterruptPending(void);
+
+/*! @brief Gets the number of times a sector has been erased.
+ *
+ *  @param address Any address in the sector.
+ *  @return uint32_t - The number of erases of the sector.
+ */
+uint32_t FlashSim_SectorErases(const uint32_t address);
+
+/*! @brief Gets the totals since the simulation started.
+ *
+ *  @param stats A pointer to where the statistics are to be copied.
+ */
+void FlashSim_GetStats(TFlashSimStats* const stats);
+
+#endif
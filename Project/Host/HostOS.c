@@ -0,0 +1,273 @@
+/*! @file
+ *
+ *  @brief Routines that stand in for the RTOS when the Flash modules are built on a PC.
+ *
+ *  Threads are run one at a time with ucontext, highest priority first. A thread runs until it waits on a
+ *  semaphore, delays, or signals a higher priority thread. When no thread is ready, time jumps straight to the
+ *  next delay or the end of the Flash command in progress, and the FTFE interrupt is taken between threads.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+/*!
+**  @addtogroup HostOS_module HostOS module documentation
+**  @{
+*/
+/* MODULE HostOS */
+
+#include <stdlib.h>
+#include <ucontext.h>
+#include "brOS.h"
+
+// One OS tick, in core clock cycles
+#define TICK_CYCLES (CPU_CORE_CLK_HZ / 1000)
+
+// Host threads need far more stack than the tower's, so the stacks passed in are not used
+#define HOST_STACK_SIZE 0x10000
+
+#define NB_PRIORITIES (OS_LOWEST_PRIORITY + 1)
+
+typedef struct
+{
+  ucontext_t context;
+  void (*thread)(void* pd);
+  void*    pData;
+  OS_STATE state;
+  OS_ECB*  event;     // Semaphore being waited on
+  uint64_t wake;      // Time the delay or timeout ends, 0 for none
+  bool     timedOut;
+} TThread;
+
+static TThread Threads[NB_PRIORITIES];
+static OS_ECB Events[OS_MAX_EVENTS];
+static uint8_t NbEvents;
+static int Current = -1;           // Priority of the running thread, -1 between threads
+static ucontext_t Scheduler;
+static uint32_t NbPackets;
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Returns to the scheduler, which runs the highest priority ready thread.
+ */
+static void Yield(void)
+{
+  int self = Current;
+
+  swapcontext(&Threads[self].context, &Scheduler);
+}
+
+/*! @brief Runs a thread function and marks the thread dormant if it ever returns.
+ *
+ *  @param priority The priority of the thread.
+ */
+static void Start(int priority)
+{
+  Threads[priority].thread(Threads[priority].pData);
+  Threads[priority].state = OS_STATE_DORMANT;
+}
+
+/*! @brief Takes the FTFE interrupt for as long as it is requested.
+ */
+static void TakeInterrupts(void)
+{
+  while (FlashSim_InterruptPending())
+    FTFE_ISR();
+}
+
+// PUBLIC FUNCTIONS
+
+void OS_Init(const uint32_t cpuCoreClk, const bool toggleLED)
+{
+}
+
+void OS_ISREnter(void)
+{
+}
+
+void OS_ISRExit(void)
+{
+}
+
+OS_ECB* OS_SemaphoreCreate(const uint32_t value)
+{
+  if (NbEvents >= OS_MAX_EVENTS)
+    return NULL;
+
+  Events[NbEvents].count = value;
+  Events[NbEvents].waitList = 0;
+  return &Events[NbEvents++];
+}
+
+OS_ERROR OS_SemaphoreSignal(OS_ECB* const pEvent)
+{
+  for (int priority = 0; priority < NB_PRIORITIES; priority++)
+  {
+    if ((Threads[priority].state == OS_STATE_SEMAPHORE) && (Threads[priority].event == pEvent))
+    {
+      Threads[priority].state = OS_STATE_READY;
+      Threads[priority].event = NULL;
+
+      // A higher priority thread preempts the one signalling, interrupts just make it ready
+      if ((Current >= 0) && (priority < Current))
+        Yield();
+      return OS_NO_ERROR;
+    }
+  }
+
+  pEvent->count++;
+  return OS_NO_ERROR;
+}
+
+OS_ERROR OS_SemaphoreWait(OS_ECB* const pEvent, const uint32_t timeout)
+{
+  if (pEvent->count)
+  {
+    pEvent->count--;
+    return OS_NO_ERROR;
+  }
+
+  Threads[Current].state    = OS_STATE_SEMAPHORE;
+  Threads[Current].event    = pEvent;
+  Threads[Current].wake     = timeout ? FlashSim_Now() + (uint64_t)timeout*TICK_CYCLES : 0;
+  Threads[Current].timedOut = false;
+  Yield();
+
+  return Threads[Current].timedOut ? OS_TIMEOUT : OS_NO_ERROR;
+}
+
+void OS_Start(void)
+{
+  for (;;)
+  {
+    int next = -1;
+    uint64_t soonest = 0;
+    uint64_t flashDone;
+
+    TakeInterrupts();
+
+    for (int priority = 0; (priority < NB_PRIORITIES) && (next < 0); priority++)
+    {
+      if (Threads[priority].thread && (Threads[priority].state == OS_STATE_READY))
+        next = priority;
+    }
+
+    if (next >= 0)
+    {
+      Current = next;
+      swapcontext(&Scheduler, &Threads[next].context);
+      Current = -1;
+      continue;
+    }
+
+    // Nothing to run, so jump to whatever happens next
+    if (FlashSim_Busy(&flashDone))
+      soonest = flashDone;
+
+    for (int priority = 0; priority < NB_PRIORITIES; priority++)
+    {
+      TThread* thread = &Threads[priority];
+      bool waiting = (thread->state == OS_STATE_DELAYED) || ((thread->state == OS_STATE_SEMAPHORE) && thread->wake);
+
+      if (waiting && (!soonest || (thread->wake < soonest)))
+        soonest = thread->wake;
+    }
+
+    // Every thread is waiting on a semaphore that nothing will signal
+    if (!soonest)
+      return;
+
+    if (soonest > FlashSim_Now())
+      FlashSim_Advance(soonest - FlashSim_Now());
+
+    for (int priority = 0; priority < NB_PRIORITIES; priority++)
+    {
+      TThread* thread = &Threads[priority];
+
+      if ((thread->state == OS_STATE_DELAYED) && (thread->wake <= FlashSim_Now()))
+      {
+        thread->state = OS_STATE_READY;
+      }
+      else if ((thread->state == OS_STATE_SEMAPHORE) && thread->wake && (thread->wake <= FlashSim_Now()))
+      {
+        thread->state    = OS_STATE_READY;
+        thread->event    = NULL;
+        thread->timedOut = true;
+      }
+    }
+  }
+}
+
+OS_ERROR OS_ThreadCreate(void (*thread)(void* pd), void* pData, void* pStack, const uint8_t priority)
+{
+  TThread* new;
+
+  if (priority >= NB_PRIORITIES)
+    return OS_PRIORITY_INVALID;
+
+  new = &Threads[priority];
+
+  if (new->thread)
+    return OS_PRIORITY_EXISTS;
+
+  new->thread = thread;
+  new->pData  = pData;
+  new->state  = OS_STATE_READY;
+
+  getcontext(&new->context);
+  new->context.uc_stack.ss_sp   = malloc(HOST_STACK_SIZE);
+  new->context.uc_stack.ss_size = HOST_STACK_SIZE;
+  new->context.uc_link          = &Scheduler;
+  makecontext(&new->context, (void (*)(void))Start, 1, (int)priority);
+
+  // A thread created by a lower priority one runs straight away
+  if ((Current >= 0) && (priority < Current))
+    Yield();
+
+  return OS_NO_ERROR;
+}
+
+OS_ERROR OS_ThreadDelete(uint8_t priority)
+{
+  if (priority == OS_PRIORITY_SELF)
+    priority = Current;
+
+  Threads[priority].state = OS_STATE_DORMANT;
+  if (priority == Current)
+    Yield();
+
+  return OS_NO_ERROR;
+}
+
+void OS_TimeDelay(const uint32_t ticks)
+{
+  Threads[Current].state = OS_STATE_DELAYED;
+  Threads[Current].wake  = FlashSim_Now() + (uint64_t)ticks*TICK_CYCLES;
+  Yield();
+}
+
+uint32_t OS_TimeGet(void)
+{
+  return (uint32_t)(FlashSim_Now() / TICK_CYCLES);
+}
+
+void OS_TimeSet(const uint32_t ticks)
+{
+}
+
+void RTC_GetTimestamp(TRTCTimestamp* const timestamp)
+{
+  uint64_t now = FlashSim_Now();
+
+  // The simulated clock counts core cycles from the start of the simulation
+  timestamp->seconds  = (uint32_t)(now / CPU_CORE_CLK_HZ);
+  timestamp->fraction = (uint16_t)((now % CPU_CORE_CLK_HZ) * RTC_FRACTIONS_PER_SECOND / CPU_CORE_CLK_HZ);
+}
+
+void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
+{
+  NbPackets++;
+}
+
+/*!
+** @}
+*/
@@ -0,0 +1,61 @@
+/*! @file
+ *
+ *  @brief Stands in for Sources/brOS.h when the Flash modules are built on a PC.
+ *
+ *  Pulls in the simulated FTFE and the host OS instead of the Kinetis headers, so that Flash.c, Counter.c,
+ *  Config.c and EventLog.c compile unchanged.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+
+#ifndef HOST_BROS_H_
+#define HOST_BROS_H_
+
+#include <stddef.h>
+#include "OS.h"
+#include "types.h"
+#include "FlashSim.h"
+#include "Flash.h"
+#include "Counter.h"
+#include "Config.h"
+#include "EventLog.h"
+#include "RTC.h"
+
+// OS-related constants
+#define THREAD_STACK_SIZE   800
+
+// Thread priorities, in the same order as on the tower
+enum
+{
+  INIT_MODULES_PRIORITY,
+  UART_RX_PRIORITY,
+  UART_TX_PRIORITY,
+  LOGIC_PRIORITY,
+  RTC_PRIORITY,
+  PACKET_HANDLE_PRIORITY,
+  COUNTER_PRIORITY,
+  CONFIG_PRIORITY,
+  EVENTLOG_PRIORITY,
+  FLASH_PRIORITY,
+};
+
+// From logic.h, used for configuration defaults
+#define DEF_TIMING       0
+#define RMS_UPPER_LIMIT  3
+#define RMS_LOWER_LIMIT  2
+
+// From handle.h, used by the event log dump
+#define EVENT_LOG        0x1A
+#define EVENT_TIME       0x1B
+#define EVENT_FRACTION   0x1E
+
+// Interrupts are only taken between threads on the host, so critical sections have nothing to do
+#define EnterCritical()
+#define ExitCritical()
+
+/*! @brief Counts packets instead of sending them.
+ */
+void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3);
+
+#endif /* HOST_BROS_H_ */
@@ -0,0 +1,402 @@
+/*! @file
+ *
+ *  @brief Routines for the non-volatile configuration of the tower.
+ *
+ *  The configuration is kept as two copies in alternate sectors. Each copy is a full image holding one record
+ *  per key (its type, its value and a CRC) followed by a header with a sequence number, which is programmed last.
+ *  An update always writes a new image to the inactive sector, which is erased in the background beforehand,
+ *  so a reset at any point leaves at least one complete copy. All reads come from a RAM index built at boot.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-04
+ */
+/*!
+**  @addtogroup Config_module Config module documentation
+**  @{
+*/
+/* MODULE Config */
+
+#include "brOS.h"
+
+#define PHRASES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PHRASE_SIZE)
+
+// Key of the header record at the start of each copy, its value is the sequence number of the copy
+#define HEADER_KEY 0xFE
+
+// The raw bits of a value, whatever its type
+typedef union
+{
+  uint32_t u;
+  float    f;
+} TConfigValue;
+
+// One record fills one phrase
+typedef union
+{
+  uint64_t l;
+  struct
+  {
+    uint32_t value;  /*!< The raw bits of the value, or the sequence number in the header */
+    uint8_t  key;    /*!< The key the record belongs to, or HEADER_KEY */
+    uint8_t  type;   /*!< The type of the value, or the number of keys in the header */
+    uint16_t crc;    /*!< CRC-16 over the other fields, rejects erased and torn phrases */
+  } s;
+} TConfigRecord;
+
+// The type and default value of each key
+static const struct
+{
+  TConfigType  type;
+  TConfigValue initial;
+} Keys[CONFIG_NB_KEYS] =
+{
+  [CONFIG_TOWER_NB]        = {CONFIG_TYPE_UINT16, {.u = 1382}},  // Last 4 digits of student number
+  [CONFIG_TOWER_MODE]      = {CONFIG_TYPE_UINT16, {.u = 1}},
+  [CONFIG_TIMING_TYPE]     = {CONFIG_TYPE_UINT8,  {.u = DEF_TIMING}},
+  [CONFIG_RMS_UPPER_LIMIT] = {CONFIG_TYPE_FLOAT,  {.f = RMS_UPPER_LIMIT}},
+  [CONFIG_RMS_LOWER_LIMIT] = {CONFIG_TYPE_FLOAT,  {.f = RMS_LOWER_LIMIT}}
+};
+
+#if CONFIG_NB_KEYS + 1 > PHRASES_PER_SECTOR
+#error "The configuration image does not fit in a sector"
+#endif
+
+// Private global variables
+static volatile TConfigValue Values[CONFIG_NB_KEYS];  // RAM index, the current value of each key
+static uint8_t  ActiveSector;                         // The sector holding the newest copy
+static uint32_t Sequence;                             // Sequence number of the newest copy
+static volatile bool InactiveErased;                  // The other sector is ready for the next copy
+
+// Semaphores
+static OS_ECB* ConfigAccess;    // Only one thread may write a copy at a time
+static OS_ECB* ConfigCommitted; // Signalled when the inactive sector needs erasing
+
+OS_THREAD_STACK (ConfigThreadStack, THREAD_STACK_SIZE);
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Calculates the CRC of a record.
+ *
+ *  @param record The record to check.
+ *  @return uint16_t - The CRC-16-CCITT of the value, key and type.
+ */
+static uint16_t RecordCRC(const TConfigRecord* const record)
+{
+  uint8_t bytes[6];
+  uint16_t crc = 0xFFFF;
+
+  for (uint8_t i = 0; i < sizeof(record->s.value); i++)
+    bytes[i] = (uint8_t)(record->s.value >> (8*i));
+  bytes[4] = record->s.key;
+  bytes[5] = record->s.type;
+
+  for (uint8_t i = 0; i < sizeof(bytes); i++)
+  {
+    crc ^= (uint16_t)bytes[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+  }
+
+  return crc;
+}
+
+/*! @brief Gets the Flash address of a phrase in the log.
+ *
+ *  @param sector The log sector.
+ *  @param index The phrase within the sector.
+ *  @return uint32_t - The address of the phrase.
+ */
+static uint32_t RecordAddress(const uint8_t sector, const uint16_t index)
+{
+  return FLASH_CONFIG_START + sector*FLASH_SECTOR_SIZE + index*FLASH_PHRASE_SIZE;
+}
+
+/*! @brief Programs one record.
+ *
+ *  @param sector The log sector.
+ *  @param index The phrase within the sector.
+ *  @param key The key the record belongs to, or HEADER_KEY.
+ *  @param type The type of the value.
+ *  @param value The raw bits of the value.
+ *  @return bool - TRUE if the record was programmed.
+ */
+static bool WriteRecord(const uint8_t sector, const uint16_t index, const uint8_t key, const uint8_t type, const uint32_t value)
+{
+  TConfigRecord record;
+
+  record.s.value = value;
+  record.s.key   = key;
+  record.s.type  = type;
+  record.s.crc   = RecordCRC(&record);
+
+  return Flash_ProgramPhrase(RecordAddress(sector, index), record.l);
+}
+
+/*! @brief Reads a record and checks it.
+ *
+ *  @param sector The log sector.
+ *  @param index The phrase within the sector.
+ *  @param record Where the record is to be read to.
+ *  @return bool - TRUE if the record passes its CRC.
+ */
+static bool ReadRecord(const uint8_t sector, const uint16_t index, TConfigRecord* const record)
+{
+  record->l = _FP(RecordAddress(sector, index));
+  return record->s.crc == RecordCRC(record);
+}
+
+/*! @brief Erases the inactive sector, ready for the next copy.
+ *
+ *  @note The caller must hold ConfigAccess.
+ */
+static void EraseInactive(void)
+{
+  uint8_t inactive = (ActiveSector + 1) % FLASH_CONFIG_NB_SECTORS;
+
+  InactiveErased = Flash_EraseSector(RecordAddress(inactive, 0));
+}
+
+/*! @brief Writes a new copy of the configuration to the inactive sector and makes it the active one.
+ *
+ *  @param values The value of every key.
+ *  @return bool - TRUE if the new copy is complete.
+ *  @note The header is programmed last, so until then the active sector still holds the previous copy.
+ *        The caller must hold ConfigAccess.
+ */
+static bool Commit(const TConfigValue values[])
+{
+  uint8_t inactive = (ActiveSector + 1) % FLASH_CONFIG_NB_SECTORS;
+
+  // Normally already done in the background
+  if (!InactiveErased)
+    EraseInactive();
+
+  if (!InactiveErased)
+    return false;
+
+  InactiveErased = false;
+
+  for (uint8_t key = 0; key < CONFIG_NB_KEYS; key++)
+  {
+    if (!WriteRecord(inactive, key + 1, key, Keys[key].type, values[key].u))
+      return false;
+  }
+
+  if (!WriteRecord(inactive, 0, HEADER_KEY, CONFIG_NB_KEYS, Sequence + 1))
+    return false;
+
+  ActiveSector = inactive;
+  Sequence++;
+
+  // The previous copy can go now
+  OS_SemaphoreSignal(ConfigCommitted);
+  return true;
+}
+
+/*! @brief Reads and checks a copy of the configuration.
+ *
+ *  @param sector The sector holding the copy.
+ *  @param sequence Where the sequence number of the copy is to be written.
+ *  @param values Where the value of every key is to be written.
+ *  @return bool - TRUE if the copy is complete and every record passes its check.
+ */
+static bool ReadCopy(const uint8_t sector, uint32_t* const sequence, TConfigValue values[])
+{
+  TConfigRecord record;
+  uint8_t nbKeys;
+
+  // A copy without its header was never completed
+  if (!ReadRecord(sector, 0, &record) || (record.s.key != HEADER_KEY))
+    return false;
+
+  *sequence = record.s.value;
+  nbKeys = record.s.type;
+
+  for (uint8_t key = 0; key < CONFIG_NB_KEYS; key++)
+  {
+    values[key] = Keys[key].initial;
+
+    // Keys added since the copy was written take their default value
+    if (key >= nbKeys)
+      continue;
+
+    if (!ReadRecord(sector, key + 1, &record) || (record.s.key != key) || (record.s.type != Keys[key].type))
+      return false;
+
+    values[key].u = record.s.value;
+  }
+
+  return true;
+}
+
+/*! @brief Builds the RAM index from the newest valid copy.
+ */
+static void Recover(void)
+{
+  TConfigValue values[CONFIG_NB_KEYS];
+  uint32_t sequence;
+  bool found = false;
+  uint8_t inactive;
+
+  for (uint8_t key = 0; key < CONFIG_NB_KEYS; key++)
+    Values[key] = Keys[key].initial;
+
+  for (uint8_t sector = 0; sector < FLASH_CONFIG_NB_SECTORS; sector++)
+  {
+    if (!ReadCopy(sector, &sequence, values))
+      continue;
+
+    // Sequence numbers wrap, but the two copies are always one apart
+    if (!found || ((int32_t)(sequence - Sequence) > 0))
+    {
+      found = true;
+      ActiveSector = sector;
+      Sequence = sequence;
+      for (uint8_t key = 0; key < CONFIG_NB_KEYS; key++)
+        Values[key] = values[key];
+    }
+  }
+
+  // Without a copy, the defaults are used and the first update goes to sector 0
+  if (!found)
+  {
+    ActiveSector = FLASH_CONFIG_NB_SECTORS - 1;
+    Sequence = 0;
+  }
+
+  inactive = (ActiveSector + 1) % FLASH_CONFIG_NB_SECTORS;
+  InactiveErased = true;
+  for (uint16_t index = 0; index < PHRASES_PER_SECTOR; index++)
+  {
+    if (_FP(RecordAddress(inactive, index)) != 0xFFFFFFFFFFFFFFFFLLU)
+    {
+      InactiveErased = false;
+      break;
+    }
+  }
+}
+
+/*! @brief Writes a new copy with one value changed and updates the RAM index.
+ *
+ *  @param key The key of the value.
+ *  @param value The raw bits of the value.
+ *  @return bool - TRUE if the value was stored.
+ */
+static bool Store(const TConfigKey key, const uint32_t value)
+{
+  TConfigValue values[CONFIG_NB_KEYS];
+  bool success;
+
+  OS_SemaphoreWait(ConfigAccess, 0);
+
+  if (Values[key].u == value)
+  {
+    success = true;
+  }
+  else
+  {
+    for (uint8_t k = 0; k < CONFIG_NB_KEYS; k++)
+      values[k] = Values[k];
+    values[key].u = value;
+
+    success = Commit(values);
+
+    if (success)
+      Values[key].u = value;
+  }
+
+  OS_SemaphoreSignal(ConfigAccess);
+  return success;
+}
+
+// THREADS
+
+/*! @brief Erases the inactive sector after each update, so the next update does not have to.
+ *
+ *  @param pData is not used but is required by the OS to create a thread.
+ */
+static void ConfigThread(void* pData)
+{
+  for (;;)
+  {
+    OS_SemaphoreWait(ConfigCommitted, 0);
+
+    OS_SemaphoreWait(ConfigAccess, 0);
+    if (!InactiveErased)
+      EraseInactive();
+    OS_SemaphoreSignal(ConfigAccess);
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+bool Config_Init(void)
+{
+  Recover();
+
+  ConfigAccess    = OS_SemaphoreCreate(1);
+  ConfigCommitted = OS_SemaphoreCreate(InactiveErased ? 0 : 1);
+
+  return (OS_ThreadCreate(ConfigThread,
+                          NULL,
+                          &ConfigThreadStack[THREAD_STACK_SIZE - 1],
+                          CONFIG_PRIORITY) == OS_NO_ERROR);
+}
+
+uint32_t Config_Get(const TConfigKey key)
+{
+  if (key >= CONFIG_NB_KEYS)
+    return 0;
+
+  return Values[key].u;
+}
+
+float Config_GetFloat(const TConfigKey key)
+{
+  if (key >= CONFIG_NB_KEYS)
+    return 0;
+
+  return Values[key].f;
+}
+
+bool Config_Set(const TConfigKey key, const uint32_t value)
+{
+  if (key >= CONFIG_NB_KEYS)
+    return false;
+
+  switch (Keys[key].type)
+  {
+    case CONFIG_TYPE_UINT8:
+      if (value > 0xFF)
+        return false;
+      break;
+
+    case CONFIG_TYPE_UINT16:
+      if (value > 0xFFFF)
+        return false;
+      break;
+
+    case CONFIG_TYPE_UINT32:
+      break;
+
+    default:
+      return false;
+  }
+
+  return Store(key, value);
+}
+
+bool Config_SetFloat(const TConfigKey key, const float value)
+{
+  TConfigValue raw;
+
+  if ((key >= CONFIG_NB_KEYS) || (Keys[key].type != CONFIG_TYPE_FLOAT))
+    return false;
+
+  raw.f = value;
+  return Store(key, raw.u);
+}
+
+/*!
+** @}
+*/
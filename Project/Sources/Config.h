@@ -0,0 +1,76 @@
+/*! @file
+ *
+ *  @brief Routines for the non-volatile configuration of the tower.
+ *
+ *  This contains the functions for storing typed configuration values in Flash, as two alternating copies.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-04
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// new types
+#include "types.h"
+
+typedef enum
+{
+  CONFIG_TOWER_NB,         /*!< uint16_t - Tower number */
+  CONFIG_TOWER_MODE,       /*!< uint16_t - Tower mode */
+  CONFIG_TIMING_TYPE,      /*!< uint8_t  - DEF_TIMING or INV_TIMING */
+  CONFIG_RMS_UPPER_LIMIT,  /*!< float    - RMS voltage above which the tap is lowered */
+  CONFIG_RMS_LOWER_LIMIT,  /*!< float    - RMS voltage below which the tap is raised */
+  CONFIG_NB_KEYS
+} TConfigKey;
+
+typedef enum
+{
+  CONFIG_TYPE_UINT8,
+  CONFIG_TYPE_UINT16,
+  CONFIG_TYPE_UINT32,
+  CONFIG_TYPE_FLOAT
+} TConfigType;
+
+/*! @brief Builds the RAM index of configuration values from the newest valid copy in Flash.
+ *
+ *  Keys without a valid copy in Flash take their default value. Also starts the thread that erases the inactive copy.
+ *  @return bool - TRUE if the configuration was successfully initialized.
+ *  @note Assumes Flash has been initialized.
+ */
+bool Config_Init(void);
+
+/*! @brief Gets an integer configuration value.
+ *
+ *  @param key The key of the value.
+ *  @return uint32_t - The value, read from the RAM index.
+ */
+uint32_t Config_Get(const TConfigKey key);
+
+/*! @brief Gets a floating point configuration value.
+ *
+ *  @param key The key of the value.
+ *  @return float - The value, read from the RAM index.
+ */
+float Config_GetFloat(const TConfigKey key);
+
+/*! @brief Sets an integer configuration value and stores it in Flash.
+ *
+ *  @param key The key of the value.
+ *  @param value The new value.
+ *  @return bool - TRUE if the value is in Flash on return, FALSE if the key is a float, the value does not fit its type,
+ *                 or there is a programming error.
+ *  @note Assumes Config has been initialized. Must not be called from an ISR.
+ */
+bool Config_Set(const TConfigKey key, const uint32_t value);
+
+/*! @brief Sets a floating point configuration value and stores it in Flash.
+ *
+ *  @param key The key of the value.
+ *  @param value The new value.
+ *  @return bool - TRUE if the value is in Flash on return, FALSE if the key is not a float or there is a programming error.
+ *  @note Assumes Config has been initialized. Must not be called from an ISR.
+ */
+bool Config_SetFloat(const TConfigKey key, const float value);
+
+#endif
@@ -0,0 +1,302 @@
+/*! @file
+ *
+ *  @brief Routines for non-volatile event counters kept in a log-structured area of Flash.
+ *
+ *  Every update appends one phrase holding the new value of a counter, so counting never erases Flash.
+ *  The log is spread over several sectors that are used in turn. Each sector starts with a snapshot of all
+ *  counters, which means the oldest sector can always be erased in the background ahead of the log.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-02
+ */
+/*!
+**  @addtogroup Counter_module Counter module documentation
+**  @{
+*/
+/* MODULE Counter */
+
+#include "brOS.h"
+
+#define PHRASES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PHRASE_SIZE)
+
+// One log record fills one phrase
+typedef union
+{
+  uint64_t l;
+  struct
+  {
+    uint32_t value;     /*!< The value of the counter after the update */
+    uint16_t sequence;  /*!< Log sequence number, the newest record of a counter has the highest */
+    uint8_t  id;        /*!< The counter the record belongs to */
+    uint8_t  check;     /*!< Check byte over the other fields, rejects erased and torn phrases */
+  } s;
+} TCounterRecord;
+
+// Private global variables
+static volatile uint32_t Values[COUNTER_NB];  // RAM copy of each counter, always up to date
+static volatile uint8_t  Pending;             // Bit n is set when counter n has changed since it was logged
+static uint8_t  ActiveSector;                 // The sector being appended to
+static uint16_t LogIndex;                     // The next phrase to program in the active sector
+static uint16_t Sequence;                     // Sequence number of the next record
+static bool     SectorErased[FLASH_COUNTER_NB_SECTORS];
+
+// Semaphores
+static OS_ECB* CounterChanged;
+
+OS_THREAD_STACK (CounterThreadStack, THREAD_STACK_SIZE);
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Calculates the check byte of a record.
+ *
+ *  @param record The record to check.
+ *  @return uint8_t - The inverted XOR of the seven other bytes, which is never 0xFF for an erased phrase.
+ */
+static uint8_t RecordCheck(const TCounterRecord* const record)
+{
+  uint8_t check = record->s.id;
+
+  for (uint8_t i = 0; i < sizeof(record->s.value); i++)
+    check ^= (uint8_t)(record->s.value >> (8*i));
+
+  check ^= (uint8_t)record->s.sequence ^ (uint8_t)(record->s.sequence >> 8);
+  return ~check;
+}
+
+/*! @brief Gets the Flash address of a phrase in the log.
+ *
+ *  @param sector The log sector.
+ *  @param index The phrase within the sector.
+ *  @return uint32_t - The address of the phrase.
+ */
+static uint32_t RecordAddress(const uint8_t sector, const uint16_t index)
+{
+  return FLASH_COUNTER_START + sector*FLASH_SECTOR_SIZE + index*FLASH_PHRASE_SIZE;
+}
+
+/*! @brief Programs one record at the head of the log.
+ *
+ *  @param id The counter the record belongs to.
+ *  @param value The value to log.
+ *  @return bool - TRUE if the record was programmed.
+ *  @note The caller guarantees there is room in the active sector.
+ */
+static bool AppendRecord(const uint8_t id, const uint32_t value)
+{
+  TCounterRecord record;
+
+  record.s.value    = value;
+  record.s.sequence = Sequence++;
+  record.s.id       = id;
+  record.s.check    = RecordCheck(&record);
+
+  // A failed phrase is left behind, it will not pass the check on recovery
+  return Flash_ProgramPhrase(RecordAddress(ActiveSector, LogIndex++), record.l);
+}
+
+/*! @brief Erases a log sector.
+ *
+ *  @param sector The log sector.
+ *  @return bool - TRUE if the sector was erased.
+ */
+static bool EraseLogSector(const uint8_t sector)
+{
+  SectorErased[sector] = Flash_EraseSector(RecordAddress(sector, 0));
+  return SectorErased[sector];
+}
+
+/*! @brief Moves the head of the log into the next sector and writes a snapshot of all counters there.
+ *
+ *  @return bool - TRUE if the snapshot was written.
+ *  @note The sector that is given up still holds every value until the snapshot is complete.
+ */
+static bool OpenNextSector(void)
+{
+  uint8_t next = (ActiveSector + 1) % FLASH_COUNTER_NB_SECTORS;
+
+  // Normally already done in the background
+  if (!SectorErased[next] && !EraseLogSector(next))
+    return false;
+
+  ActiveSector = next;
+  LogIndex = 0;
+  SectorErased[next] = false;
+
+  for (uint8_t id = 0; id < COUNTER_NB; id++)
+  {
+    if (!AppendRecord(id, Values[id]))
+      return false;
+  }
+
+  return true;
+}
+
+/*! @brief Rebuilds the counters and the head of the log from Flash.
+ *
+ *  @note Only the newest record of each counter is used, so a power loss at any point loses at most the update being programmed.
+ */
+static void Recover(void)
+{
+  bool found[COUNTER_NB] = {false};
+  uint16_t newest[COUNTER_NB] = {0};
+  bool any = false;
+  uint16_t head = 0;  // Sequence number of the newest record of all
+  TCounterRecord record;
+
+  ActiveSector = FLASH_COUNTER_NB_SECTORS - 1;
+  LogIndex = PHRASES_PER_SECTOR;
+
+  for (uint8_t sector = 0; sector < FLASH_COUNTER_NB_SECTORS; sector++)
+  {
+    SectorErased[sector] = true;
+
+    for (uint16_t index = 0; index < PHRASES_PER_SECTOR; index++)
+    {
+      record.l = _FP(RecordAddress(sector, index));
+
+      if (record.l != 0xFFFFFFFFFFFFFFFFLLU)
+        SectorErased[sector] = false;
+
+      if ((record.s.id >= COUNTER_NB) || (record.s.check != RecordCheck(&record)))
+        continue;
+
+      // Sequence numbers wrap, but the whole log spans far less than half their range
+      if (!found[record.s.id] || ((int16_t)(record.s.sequence - newest[record.s.id]) > 0))
+      {
+        found[record.s.id] = true;
+        newest[record.s.id] = record.s.sequence;
+        Values[record.s.id] = record.s.value;
+      }
+
+      if (!any || ((int16_t)(record.s.sequence - head) > 0))
+      {
+        any = true;
+        head = record.s.sequence;
+        ActiveSector = sector;
+        LogIndex = index + 1;
+      }
+    }
+  }
+
+  for (uint8_t id = 0; id < COUNTER_NB; id++)
+  {
+    if (!found[id])
+      Values[id] = 0;
+  }
+
+  Sequence = head + 1;
+
+  // Skip anything a power loss left after the newest record
+  while ((LogIndex < PHRASES_PER_SECTOR) && (_FP(RecordAddress(ActiveSector, LogIndex)) != 0xFFFFFFFFFFFFFFFFLLU))
+    LogIndex++;
+
+  // Without a record in Flash, the first update opens sector 0 and writes a snapshot there
+  Pending = any ? 0 : (1 << COUNTER_NB) - 1;
+}
+
+// THREADS
+
+/*! @brief Appends changed counters to the log and erases the next sector ahead of it.
+ *
+ *  @param pData is not used but is required by the OS to create a thread.
+ */
+static void CounterThread(void* pData)
+{
+  for (;;)
+  {
+    OS_SemaphoreWait(CounterChanged, 0);
+
+    for (uint8_t id = 0; id < COUNTER_NB; id++)
+    {
+      uint32_t value;
+      bool changed, logged;
+
+      EnterCritical();
+      changed = Pending & (1 << id);
+      Pending &= ~(1 << id);
+      value = Values[id];
+      ExitCritical();
+
+      if (!changed)
+        continue;
+
+      // A fresh sector starts with a snapshot, which already holds the new value
+      if (LogIndex >= PHRASES_PER_SECTOR)
+      {
+        logged = OpenNextSector();
+        if (!logged)
+          LogIndex = PHRASES_PER_SECTOR;
+      }
+      else
+      {
+        // Retry once in the next phrase
+        logged = AppendRecord(id, value) || ((LogIndex < PHRASES_PER_SECTOR) && AppendRecord(id, value));
+      }
+
+      // Leave it pending so that the next update retries it
+      if (!logged)
+      {
+        EnterCritical();
+        Pending |= (1 << id);
+        ExitCritical();
+      }
+    }
+
+    // Compaction - every value is in the active sector's snapshot or after it, so the next sector can go
+    uint8_t next = (ActiveSector + 1) % FLASH_COUNTER_NB_SECTORS;
+    if ((LogIndex >= COUNTER_NB) && !SectorErased[next])
+      (void)EraseLogSector(next);
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+bool Counter_Init(void)
+{
+  Recover();
+
+  CounterChanged = OS_SemaphoreCreate(Pending ? 1 : 0);
+
+  return (OS_ThreadCreate(CounterThread,
+                          NULL,
+                          &CounterThreadStack[THREAD_STACK_SIZE - 1],
+                          COUNTER_PRIORITY) == OS_NO_ERROR);
+}
+
+void Counter_Increment(const TCounterID counter)
+{
+  if (counter >= COUNTER_NB)
+    return;
+
+  EnterCritical();
+  Values[counter]++;
+  if (!Pending)
+    OS_SemaphoreSignal(CounterChanged);
+  Pending |= (1 << counter);
+  ExitCritical();
+}
+
+void Counter_Reset(const TCounterID counter)
+{
+  if (counter >= COUNTER_NB)
+    return;
+
+  EnterCritical();
+  Values[counter] = 0;
+  if (!Pending)
+    OS_SemaphoreSignal(CounterChanged);
+  Pending |= (1 << counter);
+  ExitCritical();
+}
+
+uint32_t Counter_Get(const TCounterID counter)
+{
+  if (counter >= COUNTER_NB)
+    return 0;
+
+  return Values[counter];
+}
+
+/*!
+** @}
+*/
@@ -0,0 +1,54 @@
+/*! @file
+ *
+ *  @brief Routines for non-volatile event counters kept in a log-structured area of Flash.
+ *
+ *  This contains the functions for counting tap raises and lowers without erasing Flash on every count.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-02
+ */
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+// new types
+#include "types.h"
+
+typedef enum
+{
+  COUNTER_RAISES,
+  COUNTER_LOWERS,
+  COUNTER_NB
+} TCounterID;
+
+/*! @brief Recovers the counters from the Flash log and starts the thread that appends to it.
+ *
+ *  Torn records left by a power loss are skipped, and a sector left half erased is erased again in the background.
+ *  @return bool - TRUE if the counters were successfully initialized.
+ *  @note Assumes Flash has been initialized.
+ */
+bool Counter_Init(void);
+
+/*! @brief Increments a counter.
+ *
+ *  The RAM copy is updated immediately, the log record is programmed later by the counter thread.
+ *  @param counter The counter to increment.
+ *  @note Safe to call from an ISR.
+ */
+void Counter_Increment(const TCounterID counter);
+
+/*! @brief Sets a counter back to zero.
+ *
+ *  @param counter The counter to reset.
+ *  @note Safe to call from an ISR.
+ */
+void Counter_Reset(const TCounterID counter);
+
+/*! @brief Gets the value of a counter.
+ *
+ *  @param counter The counter to read.
+ *  @return uint32_t - The current value of the counter.
+ */
+uint32_t Counter_Get(const TCounterID counter);
+
+#endif
@@ -0,0 +1,356 @@
+/*! @file
+ *
+ *  @brief Routines for recording tower events in a ring buffer in Flash.
+ *
+ *  Events are timestamped and queued in RAM, then a low priority thread programs one phrase per event,
+ *  writing everything queued at once with a single Program Section command.
+ *  The log is a ring of sectors, each starting with a header that holds a sequence number. When the ring is full
+ *  the oldest sector is erased and reused, so the log always holds the most recent events.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-05
+ */
+/*!
+**  @addtogroup EventLog_module EventLog module documentation
+**  @{
+*/
+/* MODULE EventLog */
+
+#include "brOS.h"
+
+#define PHRASES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PHRASE_SIZE)
+
+// Event of the record at the start of each sector, its time is the sequence number of the sector
+#define EVENT_HEADER 0xE
+
+// Fraction of a second kept in a record, 1/8192 s is finer than a millisecond
+#define FRACTION_BITS 13
+
+// One record fills one phrase, the event and fraction are packed to keep the fraction below a millisecond
+typedef union
+{
+  uint64_t l;
+  struct
+  {
+    uint32_t time;                     /*!< RTC epoch seconds when the event was posted */
+    uint32_t event    : 4;             /*!< The event, or EVENT_HEADER */
+    uint32_t value    : 8;             /*!< Depends on the event */
+    uint32_t fraction : FRACTION_BITS; /*!< 1/8192 s into the second when the event was posted */
+    uint32_t check    : 7;             /*!< Check over the other fields, rejects erased and torn phrases */
+  } s;
+} TEventRecord;
+
+// Private global variables
+static TEventRecord Queue[EVENTLOG_QUEUE_SIZE];  // Events waiting to be programmed
+static volatile uint8_t QueueStart;
+static volatile uint8_t NbQueued;
+static volatile uint32_t NbDropped;
+
+static uint8_t  ActiveSector;  // The sector being appended to
+static uint16_t LogIndex;      // The next phrase to program in the active sector
+static uint32_t Sequence;      // Sequence number of the active sector
+
+// Semaphores
+static OS_ECB* EventQueued;  // Signalled when the queue goes from empty to not empty
+static OS_ECB* EventAccess;  // Keeps a dump from reading a sector while it is being reused
+
+OS_THREAD_STACK (EventLogThreadStack, THREAD_STACK_SIZE);
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Calculates the check byte of a record.
+ *
+ *  @param record The record to check.
+ *  @return uint8_t - The low 7 bits of the inverted XOR of the bytes of the other fields, which is never 0x7F for an erased phrase.
+ */
+static uint8_t RecordCheck(const TEventRecord* const record)
+{
+  uint8_t check = record->s.event ^ record->s.value ^ (uint8_t)record->s.fraction ^ (uint8_t)(record->s.fraction >> 8);
+
+  for (uint8_t i = 0; i < sizeof(record->s.time); i++)
+    check ^= (uint8_t)(record->s.time >> (8*i));
+
+  return ~check & 0x7F;
+}
+
+/*! @brief Gets the Flash address of a phrase in the log.
+ *
+ *  @param sector The log sector.
+ *  @param index The phrase within the sector.
+ *  @return uint32_t - The address of the phrase.
+ */
+static uint32_t RecordAddress(const uint8_t sector, const uint16_t index)
+{
+  return FLASH_EVENTLOG_START + sector*FLASH_SECTOR_SIZE + index*FLASH_PHRASE_SIZE;
+}
+
+/*! @brief Reads a record and checks it.
+ *
+ *  @param sector The log sector.
+ *  @param index The phrase within the sector.
+ *  @param record Where the record is to be read to.
+ *  @return bool - TRUE if the record passes its check.
+ */
+static bool ReadRecord(const uint8_t sector, const uint16_t index, TEventRecord* const record)
+{
+  if (!Flash_ReadPhrase(RecordAddress(sector, index), &record->l))
+    return false;
+
+  return record->s.check == RecordCheck(record);
+}
+
+/*! @brief Reads the header of a sector.
+ *
+ *  @param sector The log sector.
+ *  @param sequence Where the sequence number of the sector is to be written.
+ *  @return bool - TRUE if the sector has a valid header.
+ */
+static bool ReadHeader(const uint8_t sector, uint32_t* const sequence)
+{
+  TEventRecord header;
+
+  if (!ReadRecord(sector, 0, &header) || (header.s.event != EVENT_HEADER))
+    return false;
+
+  *sequence = header.s.time;
+  return true;
+}
+
+/*! @brief Erases the oldest sector and makes it the head of the log.
+ *
+ *  @return bool - TRUE if the sector is ready to take records.
+ */
+static bool OpenNextSector(void)
+{
+  uint8_t next = (ActiveSector + 1) % FLASH_EVENTLOG_NB_SECTORS;
+  TEventRecord header;
+  bool success;
+
+  header.s.time  = Sequence + 1;
+  header.s.event = EVENT_HEADER;
+  header.s.value = 0;
+  header.s.fraction = 0;
+  header.s.check = RecordCheck(&header);
+
+  OS_SemaphoreWait(EventAccess, 0);
+  success = Flash_EraseSector(RecordAddress(next, 0)) && Flash_ProgramPhrase(RecordAddress(next, 0), header.l);
+  OS_SemaphoreSignal(EventAccess);
+
+  if (!success)
+    return false;
+
+  ActiveSector = next;
+  LogIndex = 1;
+  Sequence++;
+  return true;
+}
+
+/*! @brief Finds the head of the log from the sector headers.
+ */
+static void Recover(void)
+{
+  uint32_t sequence;
+  bool found = false;
+
+  for (uint8_t sector = 0; sector < FLASH_EVENTLOG_NB_SECTORS; sector++)
+  {
+    if (ReadHeader(sector, &sequence) && (!found || ((int32_t)(sequence - Sequence) > 0)))
+    {
+      found = true;
+      ActiveSector = sector;
+      Sequence = sequence;
+    }
+  }
+
+  // Without a sector, the first event opens sector 0
+  if (!found)
+  {
+    ActiveSector = FLASH_EVENTLOG_NB_SECTORS - 1;
+    LogIndex = PHRASES_PER_SECTOR;
+    Sequence = 0;
+    return;
+  }
+
+  // Skip everything programmed in the active sector, torn records included
+  LogIndex = PHRASES_PER_SECTOR;
+  while ((LogIndex > 1) && (_FP(RecordAddress(ActiveSector, LogIndex - 1)) == 0xFFFFFFFFFFFFFFFFLLU))
+    LogIndex--;
+}
+
+// THREADS
+
+/*! @brief Programs queued events into the log.
+ *
+ *  @param pData is not used but is required by the OS to create a thread.
+ */
+static void EventLogThread(void* pData)
+{
+  for (;;)
+  {
+    OS_SemaphoreWait(EventQueued, 0);
+
+    // Drain the queue, events posted meanwhile are picked up without another signal
+    for (;;)
+    {
+      uint64_t batch[EVENTLOG_QUEUE_SIZE];
+      uint8_t nbRecords;
+      bool logged;
+
+      // Everything queued so far goes in one batch, up to the end of the sector
+      EnterCritical();
+      nbRecords = NbQueued;
+      if (nbRecords > PHRASES_PER_SECTOR - LogIndex)
+        nbRecords = PHRASES_PER_SECTOR - LogIndex;
+      for (uint8_t i = 0; i < nbRecords; i++)
+        batch[i] = Queue[(QueueStart + i) % EVENTLOG_QUEUE_SIZE].l;
+      ExitCritical();
+
+      if (!NbQueued)
+        break;
+
+      if (!nbRecords)
+      {
+        // The sector is full, a failed erase drops the oldest event so the thread cannot get stuck
+        if (OpenNextSector())
+          continue;
+
+        nbRecords = 1;
+        logged = false;
+      }
+      else
+      {
+        if (nbRecords == 1)
+          logged = Flash_ProgramPhrase(RecordAddress(ActiveSector, LogIndex), batch[0]);
+        else
+          logged = Flash_ProgramSection(RecordAddress(ActiveSector, LogIndex), batch, nbRecords);
+
+        // Phrases of a failed write are left behind, they will not pass the check when read
+        LogIndex += nbRecords;
+      }
+
+      EnterCritical();
+      QueueStart = (QueueStart + nbRecords) % EVENTLOG_QUEUE_SIZE;
+      NbQueued -= nbRecords;
+      if (!logged)
+        NbDropped += nbRecords;
+      ExitCritical();
+    }
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+bool EventLog_Init(void)
+{
+  QueueStart = 0;
+  NbQueued = 0;
+  NbDropped = 0;
+
+  Recover();
+
+  EventQueued = OS_SemaphoreCreate(0);
+  EventAccess = OS_SemaphoreCreate(1);
+
+  return (OS_ThreadCreate(EventLogThread,
+                          NULL,
+                          &EventLogThreadStack[THREAD_STACK_SIZE - 1],
+                          EVENTLOG_PRIORITY) == OS_NO_ERROR);
+}
+
+void EventLog_Post(const TEvent event, const uint8_t value)
+{
+  TEventRecord record;
+  TRTCTimestamp timestamp;
+
+  RTC_GetTimestamp(&timestamp);
+
+  record.s.time     = timestamp.seconds;
+  record.s.event    = event;
+  record.s.value    = value;
+  record.s.fraction = timestamp.fraction >> (15 - FRACTION_BITS);  // 1/32768 s down to 1/8192 s
+  record.s.check    = RecordCheck(&record);
+
+  EnterCritical();
+
+  if (NbQueued >= EVENTLOG_QUEUE_SIZE)
+  {
+    NbDropped++;
+  }
+  else
+  {
+    Queue[(QueueStart + NbQueued) % EVENTLOG_QUEUE_SIZE] = record;
+    if (!NbQueued)
+      OS_SemaphoreSignal(EventQueued);
+    NbQueued++;
+  }
+
+  ExitCritical();
+}
+
+bool EventLog_Dump(void)
+{
+  uint8_t first = (ActiveSector + 1) % FLASH_EVENTLOG_NB_SECTORS;
+  uint16union_t count;
+  TEventRecord record;
+  uint32_t sequence;
+
+  // Count first, so the PC knows how many records to expect
+  count.l = 0;
+  for (uint8_t i = 0; i < FLASH_EVENTLOG_NB_SECTORS; i++)
+  {
+    uint8_t sector = (first + i) % FLASH_EVENTLOG_NB_SECTORS;
+
+    OS_SemaphoreWait(EventAccess, 0);
+    if (ReadHeader(sector, &sequence))
+    {
+      for (uint16_t index = 1; index < PHRASES_PER_SECTOR; index++)
+      {
+        if (ReadRecord(sector, index, &record))
+          count.l++;
+      }
+    }
+    OS_SemaphoreSignal(EventAccess);
+  }
+
+  Packet_Put(EVENT_LOG, EVENT_NONE, count.s.Lo, count.s.Hi);
+
+  // Oldest sector first, a sector reused while it is being sent is cut short
+  for (uint8_t i = 0; (i < FLASH_EVENTLOG_NB_SECTORS) && count.l; i++)
+  {
+    uint8_t sector = (first + i) % FLASH_EVENTLOG_NB_SECTORS;
+    uint32_t current;
+
+    OS_SemaphoreWait(EventAccess, 0);
+    bool valid = ReadHeader(sector, &sequence);
+    OS_SemaphoreSignal(EventAccess);
+
+    for (uint16_t index = 1; valid && (index < PHRASES_PER_SECTOR) && count.l; index++)
+    {
+      bool found;
+
+      OS_SemaphoreWait(EventAccess, 0);
+      valid = ReadHeader(sector, &current) && (current == sequence);
+      found = valid && ReadRecord(sector, index, &record);
+      OS_SemaphoreSignal(EventAccess);
+
+      if (!found)
+        continue;
+
+      Packet_Put(EVENT_LOG, record.s.event, record.s.value, (uint8_t)(record.s.time >> 24));
+      Packet_Put(EVENT_TIME, (uint8_t)record.s.time, (uint8_t)(record.s.time >> 8), (uint8_t)(record.s.time >> 16));
+      Packet_Put(EVENT_FRACTION, (uint8_t)record.s.fraction, (uint8_t)(record.s.fraction >> 8), 0);
+      count.l--;
+    }
+  }
+
+  return true;
+}
+
+uint32_t EventLog_NbDropped(void)
+{
+  return NbDropped;
+}
+
+/*!
+** @}
+*/
@@ -0,0 +1,66 @@
+/*! @file
+ *
+ *  @brief Routines for recording tower events in a ring buffer in Flash.
+ *
+ *  This contains the functions for logging alarms, tap operations and timing mode changes with an RTC timestamp,
+ *  so that incidents can be reconstructed after the link to the PC has been down.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-05
+ */
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+// new types
+#include "types.h"
+
+// Number of events that can wait in RAM for the event log thread
+#define EVENTLOG_QUEUE_SIZE 32
+
+// Kept in 4 bits of a record in Flash, so there can be no more than 14 events
+typedef enum
+{
+  EVENT_NONE,
+  EVENT_RMS_HIGH,     /*!< RMS went above the upper limit, value is the RMS of phase A in tenths of a volt */
+  EVENT_RMS_LOW,      /*!< RMS went below the lower limit, value is the RMS of phase A in tenths of a volt */
+  EVENT_RMS_NORMAL,   /*!< RMS came back inside the limits, value is the RMS of phase A in tenths of a volt */
+  EVENT_ALARM_SET,
+  EVENT_ALARM_CLEAR,
+  EVENT_RAISE,
+  EVENT_LOWER,
+  EVENT_TIMING_MODE   /*!< value is the new timing type */
+} TEvent;
+
+/*! @brief Finds the head of the event log in Flash and starts the thread that appends to it.
+ *
+ *  @return bool - TRUE if the event log was successfully initialized.
+ *  @note Assumes Flash and the RTC have been initialized.
+ */
+bool EventLog_Init(void);
+
+/*! @brief Records an event.
+ *
+ *  The event is timestamped and queued in RAM, the event log thread programs it into Flash later.
+ *  @param event The event to record.
+ *  @param value A value that depends on the event.
+ *  @note Never blocks, so it is safe to call from LogicThread or an ISR. The event is dropped if the queue is full.
+ */
+void EventLog_Post(const TEvent event, const uint8_t value);
+
+/*! @brief Sends every record in the log to the PC, oldest first.
+ *
+ *  A count packet is sent first, then three packets per record: the event with the top byte of its time,
+ *  the rest of its time in seconds, and the fraction of the second in 1/8192 s, low byte first.
+ *  @return bool - TRUE if the log was read successfully.
+ *  @note Must not be called from an ISR.
+ */
+bool EventLog_Dump(void);
+
+/*! @brief Gets the number of events dropped because the queue was full.
+ *
+ *  @return uint32_t - The number of events dropped since power up.
+ */
+uint32_t EventLog_NbDropped(void);
+
+#endif
@@ -18,7 +18,62 @@
 // Private global variables
 static const uint8_t COUNT_RESET = 1;
 static const uint32_t FIXED_FREQ_CLK = 0b10;
+static const TFTMChannel* Channels[NB_CHANNELS];  // How each channel was last set up
+static volatile uint16_t Overflows;                // Upper 16 bits of the extended count
+static volatile uint32_t Captures[NB_CHANNELS];    // Latest extended capture of each input capture channel
+static volatile uint8_t Enabled;                   // Bit n is set while channel n has its interrupt enabled
+static TFTMChannel OneShots[NB_CHANNELS];          // Set up of the channels scheduled with FTM_Schedule
+static uint8_t Uses[NB_CHANNELS];                  // Number of one-shots scheduled on each channel, makes stale handles fail
+static uint16_t PulseWidths[NB_CHANNELS];          // Width of a pulse whose rising edge is still to come, 0 if none
 
+// Shortest delay that cannot be missed between reading the counter and enabling the interrupt
+#define MIN_DELAY 2
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Extends a 16-bit count of the counter to 32 bits with the number of overflows.
+ *
+ *  @param count A value of the counter, read or captured after the last overflow counted by the ISR.
+ *  @return uint32_t - The count with the overflows in the upper 16 bits.
+ */
+static uint32_t ExtendCount(const uint16_t count)
+{
+  uint16_t overflows = Overflows;
+
+  // An overflow the ISR has not counted yet belongs to counts taken after it, which are the small ones
+  if ((FTM0_SC & FTM_SC_TOF_MASK) && (count < 0x8000))
+    overflows++;
+
+  return ((uint32_t)overflows << 16) | count;
+}
+
+/*! @brief Arms an output compare channel to interrupt a number of counts from now.
+ *
+ *  @param channelNb The channel number.
+ *  @param delay The number of counts until the interrupt.
+ *  @note Must be called inside a critical section.
+ */
+static void Arm(const uint8_t channelNb, const uint16_t delay)
+{
+  FTM0_CnV(channelNb)  =   (uint16_t)(FTM0_CNT + ((delay < MIN_DELAY) ? MIN_DELAY : delay)); // Relative to now, wraps with the counter
+  FTM0_CnSC(channelNb) &= ~FTM_CnSC_CHF_MASK;   // Forget an old match
+  FTM0_CnSC(channelNb) |=  FTM_CnSC_CHIE_MASK;  // Enable interrupts
+  Enabled |= (1 << channelNb);
+}
+
+/*! @brief Checks that a channel has been claimed with FTM_Set for output compare.
+ *
+ *  @param channelNb The channel number.
+ *  @return bool - TRUE if the pin of the channel belongs to its owner.
+ *  @note Must be called inside a critical section.
+ */
+static bool OwnedOutput(const uint8_t channelNb)
+{
+  const TFTMChannel* const channel = Channels[channelNb];
+
+  // The ISR only takes a pulse to its falling edge for a channel it knows, and a one-shot owns no pin
+  return channel && (channel != &OneShots[channelNb]) && (channel->timerFunction == TIMER_FUNCTION_OUTPUT_COMPARE);
+}
 
 // PUBLIC FUNCTIONS
 
@@ -43,6 +98,9 @@ bool FTM_Init(void)
   FTM0_CNT    =  COUNT_RESET;                  // Write to CNT
   FTM0_MOD    =  FTM_MOD_MOD_MASK;             // Write to MOD
   FTM0_SC     |=  FTM_SC_CLKS(FIXED_FREQ_CLK);  // Write (10)b to two-byte CLKS register
+  FTM0_SC     |=  FTM_SC_TOIE_MASK;             // Count overflows to extend the counter to 32 bits
+
+  Overflows = 0;
 
 
   // TODO: Enable write protection
@@ -53,16 +111,61 @@ bool FTM_Init(void)
 
 bool FTM_Set(const TFTMChannel* const aFTMChannel)
 {
-  // TODO: Channel validation
+  if (aFTMChannel->channelNb >= NB_CHANNELS)
+    return false;
 
   // TODO: Disable protection on the register before writing
 
+  EnterCritical();
+  Channels[aFTMChannel->channelNb] = aFTMChannel;
+  PulseWidths[aFTMChannel->channelNb] = 0;
+  Enabled &= ~(1 << aFTMChannel->channelNb);
+  FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_CHIE_MASK;
+  ExitCritical();
+
   switch (aFTMChannel->timerFunction)
   {
     case (TIMER_FUNCTION_INPUT_CAPTURE):
-      // FIXME: Configure for input compare
-      return false;
-      // Not currently used, will configure later.
+      // Write to the MSnB:MSnA as per pg 1212 of Ref Manual
+      FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_MSB_MASK;      // Write 0
+      FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_MSA_MASK;      // Write 0
+
+      switch(aFTMChannel->ioType.inputDetection)
+      {
+        case (TIMER_INPUT_OFF):
+          // Set ELSB & ELSA registers as per pg 1212 of Ref Manual
+          FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_ELSB_MASK; // Write 0
+          FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_ELSA_MASK; // Write 0
+          break;
+
+        case (TIMER_INPUT_RISING):
+          // Set ELSB & ELSA registers as per pg 1212 of Ref Manual
+          FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_ELSB_MASK; // Write 0
+          FTM0_CnSC(aFTMChannel->channelNb) |= FTM_CnSC_ELSA_MASK;  // Write 1
+          break;
+
+        case (TIMER_INPUT_FALLING):
+          // Set ELSB & ELSA registers as per pg 1212 of Ref Manual
+          FTM0_CnSC(aFTMChannel->channelNb) |= FTM_CnSC_ELSB_MASK;  // Write 1
+          FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_ELSA_MASK; // Write 0
+          break;
+
+        case (TIMER_INPUT_ANY):
+          // Set ELSB & ELSA registers as per pg 1212 of Ref Manual
+          FTM0_CnSC(aFTMChannel->channelNb) |= FTM_CnSC_ELSB_MASK;  // Write 1
+          FTM0_CnSC(aFTMChannel->channelNb) |= FTM_CnSC_ELSA_MASK;  // Write 1
+          break;
+      }
+
+      // Capture continuously, every edge interrupts
+      FTM0_CnSC(aFTMChannel->channelNb) &= ~FTM_CnSC_CHF_MASK;
+      if (aFTMChannel->ioType.inputDetection != TIMER_INPUT_OFF)
+      {
+        EnterCritical();
+        FTM0_CnSC(aFTMChannel->channelNb) |= FTM_CnSC_CHIE_MASK;
+        Enabled |= (1 << aFTMChannel->channelNb);
+        ExitCritical();
+      }
       break;
 
       case (TIMER_FUNCTION_OUTPUT_COMPARE):
@@ -98,76 +201,203 @@ bool FTM_Set(const TFTMChannel* const aFTMChannel)
       }
       break;
   }
+
+  return true;
+}
+
+uint32_t FTM_GetCount(void)
+{
+  uint32_t count;
+
+  EnterCritical();
+  count = ExtendCount(FTM0_CNT);
+  ExitCritical();
+
+  return count;
+}
+
+uint32_t FTM_GetCapture(const uint8_t channelNb)
+{
+  if (channelNb >= NB_CHANNELS)
+    return 0;
+
+  return Captures[channelNb];
 }
 
 
 bool FTM_StartTimer(const TFTMChannel* const aFTMChannel)
 {
-  // TODO: Channel validation
+  if ((aFTMChannel->channelNb >= NB_CHANNELS) || (aFTMChannel->timerFunction != TIMER_FUNCTION_OUTPUT_COMPARE))
+    return false;
 
-  // TODO: Do timerFunction check
+  EnterCritical();
 
+  // A one-shot scheduled on the channel would be lost and its handle would cancel this timer
+  if (Channels[aFTMChannel->channelNb] == &OneShots[aFTMChannel->channelNb])
+  {
+    ExitCritical();
+    return false;
+  }
 
-  FTM0_C0V  =   aFTMChannel->delayCount;  // Load up a value into channel 0
-  FTM0_C0SC |=  FTM_CnSC_CHIE_MASK;                // Enable interrupts
+  Channels[aFTMChannel->channelNb] = aFTMChannel;
+  Arm(aFTMChannel->channelNb, aFTMChannel->delayCount);
+  ExitCritical();
 
   return true;
 }
 
+bool FTM_SetOutput(const uint8_t channelNb, const bool high)
+{
+  if (channelNb >= NB_CHANNELS)
+    return false;
+
+  EnterCritical();
+  if (!OwnedOutput(channelNb))
+  {
+    ExitCritical();
+    return false;
+  }
 
-void __attribute__ ((interrupt)) FTM0_ISR(void)
+  PulseWidths[channelNb] = 0;
+  Enabled &= ~(1 << channelNb);
+
+  // Output compare that sets or clears the pin on match, without an interrupt
+  FTM0_CnSC(channelNb) = FTM_CnSC_MSA_MASK | FTM_CnSC_ELSB_MASK | (high ? FTM_CnSC_ELSA_MASK : 0);
+  FTM0_CnV(channelNb)  = (uint16_t)(FTM0_CNT + MIN_DELAY);
+  ExitCritical();
+
+  return true;
+}
+
+bool FTM_Pulse(const uint8_t channelNb, const uint16_t width)
 {
-  OS_ISREnter();
+  if (channelNb >= NB_CHANNELS)
+    return false;
 
-  // TODO: Determine reason for varied delay in Blue LED
+  EnterCritical();
+  if (!OwnedOutput(channelNb))
+  {
+    ExitCritical();
+    return false;
+  }
+
+  PulseWidths[channelNb] = (width < MIN_DELAY) ? MIN_DELAY : width;
+
+  // Set on match for the rising edge, the ISR turns it into clear on match for the falling edge
+  FTM0_CnSC(channelNb) = FTM_CnSC_MSA_MASK | FTM_CnSC_ELSB_MASK | FTM_CnSC_ELSA_MASK;
+  Arm(channelNb, MIN_DELAY);
+  ExitCritical();
+
+  return true;
+}
+
+bool FTM_Schedule(const uint16_t delay, void (*userFunction)(void*), void* userArguments, TFTMHandle* const handle)
+{
+  EnterCritical();
 
-  // Interrupt has occurred for FTM0 -- which channel could it be?!
-  for (int i = 0; i < NB_CHANNELS; i++)
+  for (uint8_t i = 0; i < NB_CHANNELS; i++)
   {
-  // Check if channel i has interrupts enabled and has interrupt flag set
-    if ((FTM0_CnSC(i) & FTM_CnSC_CHIE_MASK) && (FTM0_CnSC(i) & FTM_CnSC_CHF_MASK))
-    {
-      FTM0_CnSC(i) &= ~FTM_CnSC_CHF_MASK;   // Clear the flag
-      FTM0_CnSC(i) &= ~FTM_CnSC_CHIE_MASK;  // Turn off the interrupts, the timer has run its purpose.
+    // Free when nobody has set the channel up and no one-shot is using it
+    if (Channels[i])
+      continue;
+
+    OneShots[i].channelNb               = i;
+    OneShots[i].delayCount              = delay;
+    OneShots[i].timerFunction           = TIMER_FUNCTION_OUTPUT_COMPARE;
+    OneShots[i].ioType.outputAction     = TIMER_OUTPUT_DISCONNECT;
+    OneShots[i].userFunction            = userFunction;
+    OneShots[i].userArguments           = userArguments;
+    Channels[i] = &OneShots[i];
+
+    // Software compare only, the pin is left alone
+    FTM0_CnSC(i) = FTM_CnSC_MSA_MASK;
+    Arm(i, delay);
+
+    *handle = ((TFTMHandle)(++Uses[i]) << 8) | i;
+    ExitCritical();
+    return true;
+  }
 
-      // Move to necessary processing for each channel.
-      switch(i)
-      {
-        case 0:
-          // Channel 0 Processing
-          LEDs_Off(LED_BLUE);
-          break;
+  ExitCritical();
+  *handle = FTM_NO_HANDLE;
+  return false;
+}
+
+bool FTM_Cancel(const TFTMHandle handle)
+{
+  uint8_t i = (uint8_t)handle;
+  bool cancelled = false;
 
-        case 1:
-          // Channel 1 Processing
+  if (i >= NB_CHANNELS)
+    return false;
 
-          break;
+  EnterCritical();
+  if ((Channels[i] == &OneShots[i]) && (Uses[i] == (uint8_t)(handle >> 8)))
+  {
+    FTM0_CnSC(i) &= ~FTM_CnSC_CHIE_MASK;
+    Enabled &= ~(1 << i);
+    Channels[i] = NULL;
+    cancelled = true;
+  }
+  ExitCritical();
 
-        case 2:
-          // Channel 2 Processing
-          break;
+  return cancelled;
+}
 
-        case 3:
-          // Channel 3 Processing
-          break;
 
-        case 4:
-          // Channel 4 Processing
-          break;
+void __attribute__ ((interrupt)) FTM0_ISR(void)
+{
+  OS_ISREnter();
 
-        case 5:
-          // Channel 5 Processing
-          break;
+  // One read finds every channel that has interrupted, channels with their interrupt off are ignored
+  uint8_t pending = (uint8_t)FTM0_STATUS & Enabled;
 
-        case 6:
-          // Channel 6 Processing
-          break;
+  // Clear the flags by writing 0 to them, writing 1 leaves the others alone
+  FTM0_STATUS = (uint8_t)~pending;
 
-        case 7:
-          // Channel 7 Processing
-          break;
-      }
+  while (pending)
+  {
+    uint8_t i = (uint8_t)__builtin_ctz(pending);  // Lowest pending channel
+    const TFTMChannel* const channel = Channels[i];
+
+    pending &= pending - 1;
+
+    // Cancelled by a higher priority ISR since the status was read
+    if (!channel)
+      continue;
+
+    // Input capture channels keep capturing, output compare channels have run their purpose
+    if (channel->timerFunction == TIMER_FUNCTION_INPUT_CAPTURE)
+    {
+      Captures[i] = ExtendCount(FTM0_CnV(i));
+    }
+    else if (PulseWidths[i])
+    {
+      // The pin has just gone high, it goes low again exactly the width later
+      FTM0_CnSC(i) &= ~FTM_CnSC_ELSA_MASK;
+      FTM0_CnV(i)  =  (uint16_t)(FTM0_CnV(i) + PulseWidths[i]);
+      PulseWidths[i] = 0;
+      continue;
     }
+    else
+    {
+      FTM0_CnSC(i) &= ~FTM_CnSC_CHIE_MASK;
+      Enabled &= ~(1 << i);
+
+      // A scheduled one-shot gives its channel back before the callback, which may schedule again
+      if (channel == &OneShots[i])
+        Channels[i] = NULL;
+    }
+
+    if (channel->userFunction)
+      (*channel->userFunction)(channel->userArguments);
+  }
+
+  // Overflows are counted after the captures, which have already accounted for a pending one
+  if (FTM0_SC & FTM_SC_TOF_MASK)
+  {
+    FTM0_SC &= ~FTM_SC_TOF_MASK;  // Clear the flag by reading it set then writing 0
+    Overflows++;
   }
 
   OS_ISRExit();
@@ -18,6 +18,10 @@
 // It's placed in the header file to be available to main.c and FTM.c
 #define NB_CHANNELS 8
 
+// Handle of a one-shot scheduled with FTM_Schedule, the channel in the low byte and a use count in the high byte
+typedef uint16_t TFTMHandle;
+#define FTM_NO_HANDLE 0xFFFF
+
 typedef enum
 {
   TIMER_FUNCTION_INPUT_CAPTURE,
@@ -74,21 +78,82 @@ bool FTM_Init(void);
  *    userFunction is a pointer to a user callback function.
  *    userArguments is a pointer to the user arguments to use with the user callback function.
  *  @return bool - TRUE if the timer was set up successfully.
+ *  @note The structure must stay allocated, the ISR uses it. An input capture channel starts capturing immediately,
+ *        its pin has to be routed to the FTM by the caller.
  *  @note Assumes the FTM has been initialized.
  */
 bool FTM_Set(const TFTMChannel* const aFTMChannel);
 
+/*! @brief Gets the count of the free running counter, extended to 32 bits.
+ *
+ *  @return uint32_t - The number of fixed frequency clock periods since the FTM was initialized, modulo 2^32.
+ *  @note Assumes the FTM has been initialized.
+ */
+uint32_t FTM_GetCount(void);
+
+/*! @brief Gets the latest capture of an input capture channel.
+ *
+ *  @param channelNb The channel number.
+ *  @return uint32_t - The count at the latest captured edge, extended to 32 bits like FTM_GetCount.
+ *  @note Called from the channel's user callback, this is the edge that caused it.
+ */
+uint32_t FTM_GetCapture(const uint8_t channelNb);
+
 /*! @brief Starts a timer if set up for output compare.
  *
+ *  The timer runs out delayCount fixed frequency clock periods from now.
  *  @param aFTMChannel is a structure containing the parameters to be used in setting up the timer channel.
- *  @return bool - TRUE if the timer was started successfully.
+ *  @return bool - TRUE if the timer was started successfully, FALSE if a one-shot from FTM_Schedule is using the channel.
  *  @note Assumes the FTM has been initialized.
  */
 bool FTM_StartTimer(const TFTMChannel* const aFTMChannel);
 
+/*! @brief Schedules a one-shot on any channel that is free.
+ *
+ *  The compare value is the counter now plus the delay, so the delay does not depend on when the counter last wrapped.
+ *  @param delay The delay in fixed frequency clock periods, from 2 to 65535.
+ *  @param userFunction is a pointer to a user callback function, called from the FTM ISR.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @param handle The address of a variable to store the handle of the one-shot.
+ *  @return bool - TRUE if a channel was free and the one-shot was scheduled.
+ *  @note Channels set up with FTM_Set are never used. Safe to call from an ISR, including a one-shot callback.
+ */
+bool FTM_Schedule(const uint16_t delay, void (*userFunction)(void*), void* userArguments, TFTMHandle* const handle);
+
+/*! @brief Cancels a one-shot scheduled with FTM_Schedule.
+ *
+ *  @param handle The handle of the one-shot.
+ *  @return bool - TRUE if the one-shot was cancelled, FALSE if it had already fired or been cancelled.
+ *  @note Safe to call from an ISR.
+ */
+bool FTM_Cancel(const TFTMHandle handle);
+
+/*! @brief Drives the pin of an output compare channel high or low.
+ *
+ *  The level is set by the channel's own output compare a couple of counts from now, and a pulse in progress is cut short.
+ *  @param channelNb The channel number.
+ *  @param high TRUE to drive the pin high, FALSE to drive it low.
+ *  @return bool - TRUE if the output was set, FALSE if the channel has not been set up with FTM_Set for output compare.
+ *  @note The channel's pin has to be routed to the FTM by the caller. Safe to call from an ISR.
+ */
+bool FTM_SetOutput(const uint8_t channelNb, const bool high);
+
+/*! @brief Drives the pin of an output compare channel high for a number of counts.
+ *
+ *  Both edges are output compares, so the width of the pulse is exact. The ISR only sets up the second edge.
+ *  @param channelNb The channel number.
+ *  @param width The width of the pulse in fixed frequency clock periods, from 2 to 65535.
+ *  @return bool - TRUE if the pulse was started, FALSE if the channel has not been set up with FTM_Set for output compare.
+ *  @note The channel's pin has to be routed to the FTM by the caller. The ISR ends the pulse only on a channel
+ *        that stays set up, so a channel set up again with FTM_Set loses a pulse in progress. Safe to call from an ISR.
+ */
+bool FTM_Pulse(const uint8_t channelNb, const uint16_t width);
+
 /*! @brief Interrupt service routine for the FTM.
  *
- *  If a timer channel was set up as output compare, then the user callback function will be called.
+ *  Reads FTM0_STATUS once and calls the user callback function of each channel that has interrupted.
+ *  An output compare channel then has its interrupt turned off, an input capture channel records the capture and keeps going.
+ *  Counter overflows are counted here to extend the counter to 32 bits.
  *  @note Assumes the FTM has been initialized.
  */
 void __attribute__ ((interrupt)) FTM0_ISR(void);
@@ -49,35 +49,130 @@ typedef struct
   } parameterB;  // The last 8 FCCOB registers (4-B)
 } TFCCOB;
 
+// Value of a phrase in the erased state
+#define ERASED_PHRASE 0xFFFFFFFFFFFFFFFFLLU
+
+// Address of the FlexRAM, used as programming acceleration RAM by the Program Section command
+#define FLEXRAM_START 0x14000000LU
+
+// Size of the pattern programmed by the benchmark, repeated to fill the scratch sector
+#define BENCHMARK_NB_PHRASES 128
+
+// RAM shadow of the Flash data block
+volatile uint64_t FlashShadow[FLASH_NB_PHRASES];
+
+// Bit n is set when phrase n of the shadow differs from Flash
+static uint32_t DirtyPhrases;
+
+#if FLASH_NB_PHRASES > 32
+#error "DirtyPhrases can only track 32 phrases"
+#endif
+
+// Erase and program statistics
+static TFlashStats Stats;
+
+// Commands waiting for the FTFE, the head is the one executing
+static TFlashCommand* QueueHead;
+static TFlashCommand* QueueTail;
+
+// Semaphores
+static OS_ECB* FlashDirty;   // Signalled when the shadow goes from clean to dirty
+static OS_ECB* FlashAccess;  // Only one thread may use the blocking commands at a time
+static OS_ECB* CommandDone;  // Signalled when the blocking command of the thread holding FlashAccess completes
+
+OS_THREAD_STACK (FlashThreadStack, THREAD_STACK_SIZE);
+
 // Private Functions
 
-/*! @brief Executes the received flash command.
+/*! @brief Launches the loaded command and waits for it to complete, without fetching anything from Flash.
  *
- *  @param commonCommandObject A pointer to an FCCOB type that holds the flash command and parameters to be excuted.
- *  @return bool - TRUE if the command is successfully executed.
+ *  Used for commands on block 0, which holds the code and vector table.
+ *  @note Placed in RAM by the linker. Interrupts are disabled until the command completes.
  */
-static bool LaunchCommand(TFCCOB* commonCommandObject)
+static void __attribute__ ((section(".ramfunc"), long_call, noinline)) LaunchFromRAM(void)
 {
-  while (!(FTFE_FSTAT & FTFE_FSTAT_CCIF_MASK));  // Keep checking FSTAT until CCIF is set
+  EnterCritical();
+  FTFE_FSTAT = FTFE_FSTAT_CCIF_MASK;
+  while (!(FTFE_FSTAT & FTFE_FSTAT_CCIF_MASK));
+  ExitCritical();
+}
+
+/*! @brief Loads a command into the FTFE and launches it.
+ *
+ *  @param command The command to launch.
+ *  @note Must be called inside a critical section, with the command engine idle.
+ */
+static void LaunchCommand(TFlashCommand* const command)
+{
+  TFCCOB fccob;
+
+  fccob.command = command->command;
+  fccob.parameterA.combined = command->address;
+  fccob.parameterB.combined = command->phrase;
+
+  if (command->command == FLASH_CMD_PROGRAM_SECTION)
+  {
+    // The data is staged in the programming acceleration RAM, which can only be written while the FTFE is idle
+    for (uint16_t i = 0; i < command->nbPhrases; i++)
+      _FP(FLEXRAM_START + i*FLASH_PHRASE_SIZE) = command->data[i];
+
+    // The number of phrases goes in FCCOB4 (high byte) and FCCOB5
+    fccob.parameterB.combined = (uint64_t)command->nbPhrases << 48;
+  }
+
   FTFE_FSTAT = FTFE_FSTAT_ACCERR_MASK;  // Write 1 to clear access error flag
   FTFE_FSTAT = FTFE_FSTAT_FPVIOL_MASK;  // Write 1 to clear flash protection violation flag
 
-  FTFE_FCCOB0 = commonCommandObject->command;
-  FTFE_FCCOB1 = commonCommandObject->parameterA.separate.flashAddress2;
-  FTFE_FCCOB2 = commonCommandObject->parameterA.separate.flashAddress1;
-  FTFE_FCCOB3 = commonCommandObject->parameterA.separate.flashAddress0;
-  FTFE_FCCOB4 = commonCommandObject->parameterB.separate.dataByte7;
-  FTFE_FCCOB5 = commonCommandObject->parameterB.separate.dataByte6;
-  FTFE_FCCOB6 = commonCommandObject->parameterB.separate.dataByte5;
-  FTFE_FCCOB7 = commonCommandObject->parameterB.separate.dataByte4;
-  FTFE_FCCOB8 = commonCommandObject->parameterB.separate.dataByte3;
-  FTFE_FCCOB9 = commonCommandObject->parameterB.separate.dataByte2;
-  FTFE_FCCOBA = commonCommandObject->parameterB.separate.dataByte1;
-  FTFE_FCCOBB = commonCommandObject->parameterB.separate.dataByte0;
-
-  FTFE_FSTAT = FTFE_FSTAT_CCIF_MASK;  // Write 1 to clear command complete interrupt flag in order launch loaded command
-  while (!(FTFE_FSTAT & FTFE_FSTAT_CCIF_MASK));
-  return true;
+  FTFE_FCCOB0 = fccob.command;
+  FTFE_FCCOB1 = fccob.parameterA.separate.flashAddress2;
+  FTFE_FCCOB2 = fccob.parameterA.separate.flashAddress1;
+  FTFE_FCCOB3 = fccob.parameterA.separate.flashAddress0;
+  FTFE_FCCOB4 = fccob.parameterB.separate.dataByte7;
+  FTFE_FCCOB5 = fccob.parameterB.separate.dataByte6;
+  FTFE_FCCOB6 = fccob.parameterB.separate.dataByte5;
+  FTFE_FCCOB7 = fccob.parameterB.separate.dataByte4;
+  FTFE_FCCOB8 = fccob.parameterB.separate.dataByte3;
+  FTFE_FCCOB9 = fccob.parameterB.separate.dataByte2;
+  FTFE_FCCOBA = fccob.parameterB.separate.dataByte1;
+  FTFE_FCCOBB = fccob.parameterB.separate.dataByte0;
+
+  command->cycles = DWT_CYCCNT;         // Start time, replaced by the latency on completion
+
+  // Block 1 keeps running code while it is busy, block 0 cannot
+  if (command->address >= FLASH_BLOCK1_START)
+    FTFE_FSTAT = FTFE_FSTAT_CCIF_MASK;  // Write 1 to clear command complete interrupt flag in order launch loaded command
+  else
+    LaunchFromRAM();
+
+  FTFE_FCNFG |= FTFE_FCNFG_CCIE_MASK;   // Interrupt when it completes
+}
+
+/*! @brief Wakes the thread waiting on a blocking command.
+ *
+ *  @param semaphore The semaphore the thread is waiting on.
+ */
+static void CommandComplete(void* semaphore)
+{
+  (void)OS_SemaphoreSignal((OS_ECB*)semaphore);
+}
+
+/*! @brief Queues a command and sleeps until it completes.
+ *
+ *  @param command The command to run.
+ *  @return bool - TRUE if the command was successfully executed.
+ *  @note The caller must hold FlashAccess, which makes it the only thread waiting on CommandDone.
+ */
+static bool RunCommand(TFlashCommand* const command)
+{
+  command->completeCallback  = CommandComplete;
+  command->completeArguments = CommandDone;
+
+  if (!Flash_Submit(command))
+    return false;
+
+  // Other threads run while the FTFE is busy
+  OS_SemaphoreWait(CommandDone, 0);
+  return command->success;
 }
 
 /*! @brief Writes 8 bytes to a phrase.
@@ -88,11 +183,12 @@ static bool LaunchCommand(TFCCOB* commonCommandObject)
  */
 static bool WritePhrase(const uint32_t address, const uint64_t phrase)
 {
-  TFCCOB write;                         // Declare an FCCOB type
-  write.command = 0x07;                 // Write the command to the FCCOB type
-  write.parameterA.combined = address;  // Write the address to the FCCOB type
-  write.parameterB.combined = phrase;   // Write the phrase to the FCCOB type
-  return LaunchCommand(&write);         // Load and execute the FCCOB
+  TFlashCommand write;
+
+  write.command = FLASH_CMD_PROGRAM_PHRASE;
+  write.address = address;
+  write.phrase  = phrase;
+  return RunCommand(&write);
 }
 
 /*! @brief Erases all bytes in a sector.
@@ -102,30 +198,182 @@ static bool WritePhrase(const uint32_t address, const uint64_t phrase)
  */
 static bool EraseSector(const uint32_t address)
 {
-  TFCCOB erase;
-  erase.command = 0x09;
-  erase.parameterA.combined = address;
-  return LaunchCommand(&erase);
+  TFlashCommand erase;
+
+  erase.command = FLASH_CMD_ERASE_SECTOR;
+  erase.address = address;
+  return RunCommand(&erase);
 }
 
-/*! @brief Erase a sector and then write a phrase.
+/*! @brief Writes consecutive phrases with one Program Section command.
  *
- *  @param address The address of the first byte of the sector.
+ *  @param address The address of the first phrase.
+ *  @param data The phrases to write.
+ *  @param nbPhrases The number of phrases, the section must not cross a sector boundary.
+ *  @return bool - TRUE if the section was successfully written.
+ */
+static bool WriteSection(const uint32_t address, const uint64_t data[], const uint16_t nbPhrases)
+{
+  TFlashCommand write;
+
+  write.command   = FLASH_CMD_PROGRAM_SECTION;
+  write.address   = address;
+  write.data      = data;
+  write.nbPhrases = nbPhrases;
+  return RunCommand(&write);
+}
+
+/*! @brief Converts a number of bytes written in a number of core clock cycles to a rate.
+ *
+ *  @param nbBytes The number of bytes written.
+ *  @param cycles The core clock cycles taken.
+ *  @return uint32_t - The rate in bytes per second.
+ */
+static uint32_t BytesPerSecond(const uint32_t nbBytes, const uint32_t cycles)
+{
+  if (!cycles)
+    return 0;
+
+  return (uint32_t)(((uint64_t)nbBytes * CPU_CORE_CLK_HZ) / cycles);
+}
+
+/*! @brief Checks whether a phrase can be written without erasing its sector.
+ *
+ *  The FTFE programs a phrase once between erases, programming it again overstresses the array even if no bit goes
+ *  from 0 to 1. So a phrase that changes must still be erased.
+ *  @param current The phrase as it is in Flash.
  *  @param phrase The value of the phrase being written.
- *  @return bool - TRUE if phrase was successfully modified.
+ *  @return bool - TRUE if the phrase already holds the value or is erased.
  */
-static bool ModifyPhrase(const uint32_t address, const uint64_t phrase)
+static bool ProgrammableInPlace(const uint64_t current, const uint64_t phrase)
 {
-  if (!EraseSector(address))
-    return false;
+  return (phrase == current) || (current == ERASED_PHRASE);
+}
+
+/*! @brief Writes an image of a sector's phrases, erasing the sector only when it has to.
+ *
+ *  All dirty phrases are committed with at most a single erase, rather than one erase per variable.
+ *  If every phrase that changes is still erased (such as the first write after an erase), they are programmed in place.
+ *  @param address The address of the first byte of the sector.
+ *  @param image The phrases to be written, starting at address.
+ *  @param nbPhrases The number of phrases in image.
+ *  @return bool - TRUE if the image was successfully written.
+ */
+static bool CommitSector(const uint32_t address, const uint64_t image[], const uint8_t nbPhrases)
+{
+  bool erase = false;
+
+  for (uint8_t i = 0; i < nbPhrases; i++)
+  {
+    if (!ProgrammableInPlace(_FP(address + i*FLASH_PHRASE_SIZE), image[i]))
+    {
+      erase = true;
+      break;
+    }
+  }
+
+  if (erase)
+  {
+    if (!EraseSector(address))
+      return false;
+    Stats.NbErases++;
+  }
+  else
+  {
+    Stats.NbErasesSaved++;
+  }
+
+  for (uint8_t i = 0; i < nbPhrases; i++)
+  {
+    // Phrases already holding the right value need no program (erased phrases after an erase included)
+    if (image[i] == _FP(address + i*FLASH_PHRASE_SIZE))
+    {
+      Stats.NbPhrasesSkipped++;
+      continue;
+    }
+
+    if (!WritePhrase(address + i*FLASH_PHRASE_SIZE, image[i]))
+      return false;
+    Stats.NbPhrasesProgrammed++;
+  }
+
+  return true;
+}
+
+/*! @brief Checks that a variable lies wholly inside the RAM shadow and is aligned to its size.
+ *
+ *  @param address The address of the variable.
+ *  @param size The size of the variable in bytes.
+ *  @return bool - TRUE if the variable can be written to the shadow.
+ */
+static bool InShadow(volatile void* const address, const uint8_t size)
+{
+  uint32_t offset = (uint32_t)(uintptr_t)address - FLASH_SHADOW_START;
+
+  return (offset < FLASH_DATA_SIZE) && (offset % size == 0);
+}
 
-  return WritePhrase(address, phrase);
+/*! @brief Marks the phrase holding a variable as dirty and wakes the Flash thread.
+ *
+ *  @param address The address of the variable in the RAM shadow.
+ *  @note Must be called inside a critical section.
+ */
+static void MarkDirty(volatile void* const address)
+{
+  uint32_t phrase = ((uint32_t)(uintptr_t)address - FLASH_SHADOW_START) / FLASH_PHRASE_SIZE;
+
+  // Only signal on the transition from clean to dirty, the commit picks up all writes after that
+  if (!DirtyPhrases)
+    OS_SemaphoreSignal(FlashDirty);
+
+  DirtyPhrases |= (1u << phrase);
+}
+
+// THREADS
+
+/*! @brief Lazily commits the RAM shadow to Flash.
+ *
+ *  Runs at the lowest priority so commits happen when the tower is otherwise idle.
+ *  @param pData is not used but is required by the OS to create a thread.
+ */
+static void FlashThread(void* pData)
+{
+  for (;;)
+  {
+    OS_SemaphoreWait(FlashDirty, 0);
+
+    OS_TimeDelay(FLASH_COMMIT_DELAY);  // Let writes that follow closely coalesce into the same commit
+    (void)Flash_Sync();
+  }
 }
 
 // Public Functions
 bool Flash_Init(void)
 {
-  return true;
+  // Reads come from RAM from now on
+  for (uint8_t i = 0; i < FLASH_NB_PHRASES; i++)
+    FlashShadow[i] = _FP(FLASH_DATA_START + i*FLASH_PHRASE_SIZE);
+
+  DirtyPhrases = 0;
+  QueueHead = NULL;
+  QueueTail = NULL;
+
+  FlashDirty  = OS_SemaphoreCreate(0);
+  FlashAccess = OS_SemaphoreCreate(1);
+  CommandDone = OS_SemaphoreCreate(0);
+
+  // Set NVIC bits
+  // Enable interrupts from the FTFE command complete
+  // NVIC non-IPR=0, IPR=4
+  // Vector=34, IRQ=18
+  FTFE_FCNFG &= ~FTFE_FCNFG_CCIE_MASK;
+  NVICICPR0 = (1 << 18);
+  NVICISER0 = (1 << 18);
+
+  return (OS_ThreadCreate(FlashThread,
+                          NULL,
+                          &FlashThreadStack[THREAD_STACK_SIZE - 1],
+                          FLASH_PRIORITY) == OS_NO_ERROR);
 }
 
 bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
@@ -139,7 +387,7 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
   {
     case 1:
     {
-      uint8_t* bytePtr = (uint8_t*)FLASH_DATA_START;  // Pointer to the first byte of the phrase being used
+      uint8_t* bytePtr = (uint8_t*)FLASH_SHADOW_START;  // Pointer to the first byte of the phrase being used
       for (uint8_t i = 0; i < 8; i++)
       {
         if (FLASH_MAP & byteMask)
@@ -156,7 +404,7 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
 
     case 2:
     {
-      uint16_t* halfwordPtr = (uint16_t*)FLASH_DATA_START;  // Pointer to the first half-word of the phrase being used
+      uint16_t* halfwordPtr = (uint16_t*)FLASH_SHADOW_START;  // Pointer to the first half-word of the phrase being used
       for (uint8_t i = 0; i < 4; i++)
       {
         if (FLASH_MAP & halfwordMask)
@@ -173,7 +421,7 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
 
     case 4:
     {
-      uint32_t* wordPtr = (uint32_t*)FLASH_DATA_START;  // Pointer to the first word of the phrase being used
+      uint32_t* wordPtr = (uint32_t*)FLASH_SHADOW_START;  // Pointer to the first word of the phrase being used
       for (uint8_t i = 0; i < 2; i++)
       {
         if (FLASH_MAP & wordMask)
@@ -194,135 +442,339 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
 
 bool Flash_Write32(volatile uint32_t* const address, const uint32_t data)
 {
-  uint32_t newAddress = FLASH_DATA_START;
-  uint64union_t phraseBuffer;
+  if (!InShadow(address, sizeof(data)))
+    return false;
 
-  if (address == (volatile uint32_t*)FLASH_DATA_START)
-  {
-    phraseBuffer.s.Hi = data;
-    phraseBuffer.s.Lo = _FW(address + 1);
-  }
+  EnterCritical();
+  *address = data;
+  MarkDirty(address);
+  ExitCritical();
+
+  return true;
+}
+
+bool Flash_Write16(volatile uint16_t* const address, const uint16_t data)
+{
+  if (!InShadow(address, sizeof(data)))
+    return false;
+
+  EnterCritical();
+  *address = data;
+  MarkDirty(address);
+  ExitCritical();
+
+  return true;
+}
+
+bool Flash_Write8(volatile uint8_t* const address, const uint8_t data)
+{
+  if (!InShadow(address, sizeof(data)))
+    return false;
 
-  else if (address == (volatile uint32_t*)(FLASH_DATA_START+4))
+  EnterCritical();
+  *address = data;
+  MarkDirty(address);
+  ExitCritical();
+
+  return true;
+}
+
+bool Flash_Sync(void)
+{
+  uint64_t image[FLASH_NB_PHRASES];
+  uint32_t dirty;
+  bool success = true;
+
+  OS_SemaphoreWait(FlashAccess, 0);
+
+  // Take a consistent snapshot, writes made during the commit will mark the shadow dirty again
+  EnterCritical();
+  dirty = DirtyPhrases;
+  DirtyPhrases = 0;
+  for (uint8_t i = 0; i < FLASH_NB_PHRASES; i++)
+    image[i] = FlashShadow[i];
+  ExitCritical();
+
+  if (dirty)
   {
-    phraseBuffer.s.Hi = _FW(address - 1);
-    phraseBuffer.s.Lo = data;
+    success = CommitSector(FLASH_DATA_START, image, FLASH_NB_PHRASES);
+
+    // Keep the phrases dirty so that the next commit retries them
+    if (!success)
+    {
+      EnterCritical();
+      DirtyPhrases |= dirty;
+      ExitCritical();
+    }
   }
 
-  else
+  OS_SemaphoreSignal(FlashAccess);
+  return success;
+}
+
+bool Flash_Erase(void)
+{
+  bool success;
+
+  OS_SemaphoreWait(FlashAccess, 0);
+
+  success = EraseSector(FLASH_DATA_START);
+
+  if (success)
   {
-    return false;
+    Stats.NbErases++;
+
+    EnterCritical();
+    for (uint8_t i = 0; i < FLASH_NB_PHRASES; i++)
+      FlashShadow[i] = ERASED_PHRASE;
+    DirtyPhrases = 0;
+    ExitCritical();
   }
 
-  return ModifyPhrase(newAddress, phraseBuffer.l);
+  OS_SemaphoreSignal(FlashAccess);
+  return success;
 }
 
-bool Flash_Write16(volatile uint16_t* const address, const uint16_t data)
+bool Flash_ProgramPhrase(const uint32_t address, const uint64_t phrase)
 {
-  volatile uint32_t* newAddress;
-  uint32union_t wordBuffer;
+  bool success;
+
+  if (address % FLASH_PHRASE_SIZE)
+    return false;
 
-  if ((uint32_t)address % 4 == 0)
+  OS_SemaphoreWait(FlashAccess, 0);
+
+  // Nothing to do if Flash already holds the value, and no way to do it without an erase if the phrase has been programmed
+  if (_FP(address) == phrase)
   {
-    newAddress = (uint32_t*)address;
-    wordBuffer.s.Lo = data;
-    wordBuffer.s.Hi = _FH(address + 1);
+    Stats.NbPhrasesSkipped++;
+    success = true;
   }
-
-  else if ((uint32_t)address % 2 == 0)
+  else if (!ProgrammableInPlace(_FP(address), phrase))
   {
-    newAddress = (uint32_t*)(address - 1);
-    wordBuffer.s.Hi = data;
-    wordBuffer.s.Lo = _FH(address - 1);
+    success = false;
   }
-
   else
   {
+    success = WritePhrase(address, phrase);
+    if (success)
+      Stats.NbPhrasesProgrammed++;
+  }
+
+  OS_SemaphoreSignal(FlashAccess);
+
+  return success;
+}
+
+bool Flash_ProgramSection(const uint32_t address, const uint64_t data[], const uint16_t nbPhrases)
+{
+  uint16_t done = 0;
+  bool success = true;
+
+  if (address % FLASH_PHRASE_SIZE)
     return false;
+
+  OS_SemaphoreWait(FlashAccess, 0);
+
+  // One command per sector, and no more than the acceleration RAM holds
+  while (success && (done < nbPhrases))
+  {
+    uint32_t chunkAddress = address + done*FLASH_PHRASE_SIZE;
+    uint16_t chunk = (FLASH_SECTOR_SIZE - (chunkAddress % FLASH_SECTOR_SIZE)) / FLASH_PHRASE_SIZE;
+
+    if (chunk > FLASH_SECTION_MAX_PHRASES)
+      chunk = FLASH_SECTION_MAX_PHRASES;
+    if (chunk > nbPhrases - done)
+      chunk = nbPhrases - done;
+
+    success = WriteSection(chunkAddress, &data[done], chunk);
+    if (success)
+    {
+      Stats.NbSectionsProgrammed++;
+      Stats.NbPhrasesProgrammed += chunk;
+    }
+    done += chunk;
   }
 
-  return Flash_Write32(newAddress, wordBuffer.l);
+  OS_SemaphoreSignal(FlashAccess);
+
+  return success;
 }
 
-bool Flash_Write8(volatile uint8_t* const address, const uint8_t data)
+bool Flash_Benchmark(uint32_t* const phraseRate, uint32_t* const sectionRate)
 {
-  volatile uint16_t* newAddress;
-  uint16union_t halfWordBuffer;
+  static uint64_t pattern[BENCHMARK_NB_PHRASES];
+  uint32_t start;
+
+  // Nothing in the pattern is erased, so no phrase is skipped
+  for (uint16_t i = 0; i < BENCHMARK_NB_PHRASES; i++)
+    pattern[i] = ((uint64_t)i << 32) | i;
 
-  if ((uint32_t) address % 2 == 0)
+  // One Program Phrase command per 8 bytes, through the same path as every other phrase write
+  if (!Flash_EraseSector(FLASH_SCRATCH_START))
+    return false;
+
+  start = DWT_CYCCNT;
+  for (uint32_t offset = 0; offset < FLASH_SECTOR_SIZE; offset += sizeof(pattern))
   {
-    newAddress = (uint16_t *) address;
-    halfWordBuffer.s.Lo = data;
-    halfWordBuffer.s.Hi = _FB(address);
+    for (uint16_t i = 0; i < BENCHMARK_NB_PHRASES; i++)
+    {
+      if (!Flash_ProgramPhrase(FLASH_SCRATCH_START + offset + i*FLASH_PHRASE_SIZE, pattern[i]))
+        return false;
+    }
   }
+  *phraseRate = BytesPerSecond(FLASH_SECTOR_SIZE, DWT_CYCCNT - start);
 
-  else
+  // One Program Section command per pattern
+  if (!Flash_EraseSector(FLASH_SCRATCH_START))
+    return false;
+
+  start = DWT_CYCCNT;
+  for (uint32_t offset = 0; offset < FLASH_SECTOR_SIZE; offset += sizeof(pattern))
   {
-    newAddress = (uint16_t *)(address - 1);
-    halfWordBuffer.s.Hi = data;
-    halfWordBuffer.s.Lo = _FB(address);
+    if (!Flash_ProgramSection(FLASH_SCRATCH_START + offset, pattern, BENCHMARK_NB_PHRASES))
+      return false;
   }
+  *sectionRate = BytesPerSecond(FLASH_SECTOR_SIZE, DWT_CYCCNT - start);
 
-  return Flash_Write16(newAddress, halfWordBuffer.l);
+  return Flash_EraseSector(FLASH_SCRATCH_START);
 }
 
-bool Flash_Erase(void)
+bool Flash_ReadPhrase(const uint32_t address, uint64_t* const phrase)
 {
-  return EraseSector(FLASH_DATA_START);
+  if (address % FLASH_PHRASE_SIZE)
+    return false;
+
+  OS_SemaphoreWait(FlashAccess, 0);
+  *phrase = _FP(address);
+  OS_SemaphoreSignal(FlashAccess);
+
+  return true;
 }
 
-bool Flash_NbLowers(void)
+bool Flash_EraseSector(const uint32_t address)
 {
-  uint16_t dummy;
-  OS_DisableInterrupts();
-  dummy = _FH(PhaseA.NvNbLowers);
+  bool success;
 
-  if (!Flash_AllocateVar((void*)&PhaseA.NvNbLowers, sizeof(*PhaseA.NvNbLowers)))
-  {
-    OS_EnableInterrupts();
+  if (address % FLASH_SECTOR_SIZE)
     return false;
-  }
 
-  else if (PhaseA.NvNbLowers->l == 0xFFFF)
+  OS_SemaphoreWait(FlashAccess, 0);
+  success = EraseSector(address);
+  if (success)
+    Stats.NbErases++;
+  OS_SemaphoreSignal(FlashAccess);
+
+  return success;
+}
+
+bool Flash_Submit(TFlashCommand* const command)
+{
+  switch (command->command)
   {
-    Flash_Write16(&(PhaseA.NvNbLowers->l), dummy+1);
-    OS_EnableInterrupts();
-    return true;
+    case FLASH_CMD_PROGRAM_PHRASE:
+    case FLASH_CMD_ERASE_SECTOR:
+      break;
+
+    case FLASH_CMD_PROGRAM_SECTION:
+      // The section has to fit the acceleration RAM, which is only there when it is not used for EEPROM
+      if (!command->data || !command->nbPhrases || (command->nbPhrases > FLASH_SECTION_MAX_PHRASES) ||
+          ((command->address % FLASH_SECTOR_SIZE) + command->nbPhrases*FLASH_PHRASE_SIZE > FLASH_SECTOR_SIZE) ||
+          !(FTFE_FCNFG & FTFE_FCNFG_RAMRDY_MASK))
+        return false;
+      break;
+
+    default:
+      return false;
   }
 
+  command->complete = false;
+  command->success  = false;
+  command->next     = NULL;
+
+  EnterCritical();
+
+  // Start it straight away if the engine is idle, otherwise the ISR launches it after those ahead of it
+  if (QueueHead)
+  {
+    QueueTail->next = command;
+    QueueTail = command;
+  }
   else
   {
-    Flash_Write16(&(PhaseA.NvNbLowers->l), PhaseA.NvNbLowers->l);
-    OS_EnableInterrupts();
-    return true;
+    QueueHead = command;
+    QueueTail = command;
+    LaunchCommand(command);
   }
+
+  ExitCritical();
+
+  return true;
+}
+
+void Flash_GetStats(TFlashStats* const stats)
+{
+  EnterCritical();
+  *stats = Stats;
+  ExitCritical();
 }
 
-bool Flash_NbRaises(void)
+void Flash_ResetStats(void)
 {
-  uint16_t dummy;
-  OS_DisableInterrupts();
-  dummy = _FH(PhaseA.NvNbRaises);
+  EnterCritical();
+  Stats = (TFlashStats){0};
+  ExitCritical();
+}
 
-  if (!Flash_AllocateVar((void*)&PhaseA.NvNbRaises, sizeof(*PhaseA.NvNbRaises)))
-  {
-    OS_EnableInterrupts();
-    return false;
-  }
+void __attribute__ ((interrupt)) FTFE_ISR(void)
+{
+  TFlashCommand* command;
+  uint8_t status;
 
-  else if (PhaseA.NvNbRaises->l == 0xFFFF)
+  OS_ISREnter();
+
+  command = QueueHead;
+  status = FTFE_FSTAT;
+
+  if (command && (status & FTFE_FSTAT_CCIF_MASK))
   {
-    Flash_Write16(&(PhaseA.NvNbRaises->l), dummy+1);
-    OS_EnableInterrupts();
-    return true;
-  }
+    command->cycles  = DWT_CYCCNT - command->cycles;
+    command->success = !(status & (FTFE_FSTAT_ACCERR_MASK | FTFE_FSTAT_FPVIOL_MASK | FTFE_FSTAT_MGSTAT0_MASK));
 
+    if (command->command == FLASH_CMD_ERASE_SECTOR)
+    {
+      Stats.LastEraseCycles = command->cycles;
+      if (command->cycles > Stats.MaxEraseCycles)
+        Stats.MaxEraseCycles = command->cycles;
+    }
+    else if (command->command == FLASH_CMD_PROGRAM_SECTION)
+    {
+      Stats.LastSectionCycles = command->cycles;
+    }
+    else
+    {
+      Stats.LastProgramCycles = command->cycles;
+      if (command->cycles > Stats.MaxProgramCycles)
+        Stats.MaxProgramCycles = command->cycles;
+    }
+
+    // Keep the FTFE busy with the next command
+    QueueHead = command->next;
+    if (QueueHead)
+      LaunchCommand(QueueHead);
+    else
+      FTFE_FCNFG &= ~FTFE_FCNFG_CCIE_MASK;  // CCIF stays set while idle
+
+    command->complete = true;
+    if (command->completeCallback)
+      command->completeCallback(command->completeArguments);
+  }
   else
   {
-    Flash_Write16(&(PhaseA.NvNbRaises->l), PhaseA.NvNbRaises->l);
-    OS_EnableInterrupts();
-    return true;
+    FTFE_FCNFG &= ~FTFE_FCNFG_CCIE_MASK;
   }
+
+  OS_ISRExit();
 }
 
 /*!
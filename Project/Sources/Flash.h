@@ -14,27 +14,107 @@
 // new types
 #include "types.h"
 
-// FLASH data access
-#define _FB(flashAddress)  *(uint8_t  volatile *)(flashAddress)
-#define _FH(flashAddress)  *(uint16_t volatile *)(flashAddress)
-#define _FW(flashAddress)  *(uint32_t volatile *)(flashAddress)
-#define _FP(flashAddress)  *(uint64_t volatile *)(flashAddress)
+// FLASH data access, through uintptr_t so that the host build can use 32-bit addresses too
+#define _FB(flashAddress)  *(uint8_t  volatile *)(uintptr_t)(flashAddress)
+#define _FH(flashAddress)  *(uint16_t volatile *)(uintptr_t)(flashAddress)
+#define _FW(flashAddress)  *(uint32_t volatile *)(uintptr_t)(flashAddress)
+#define _FP(flashAddress)  *(uint64_t volatile *)(uintptr_t)(flashAddress)
+
+// Program Flash is two 512 KB blocks - code runs from block 0, non-volatile data lives in block 1 (m_nvdata in the linker file)
+// so that block 1 can be erased and programmed while code keeps executing
+#define FLASH_BLOCK1_START 0x00080000LU
 
 // Address of the start of the Flash block we are using for data storage
 #define FLASH_DATA_START 0x00080000LU
 // Address of the end of the Flash block we are using for data storage
 #define FLASH_DATA_END   0x00080007LU
 
+// The log of counter updates takes the sectors following the data block
+#define FLASH_COUNTER_START      0x00081000LU
+#define FLASH_COUNTER_NB_SECTORS 4
+
+// The configuration store takes the sectors following the counter log
+#define FLASH_CONFIG_START      0x00085000LU
+#define FLASH_CONFIG_NB_SECTORS 2
+
+// The event log takes the sectors following the configuration store
+#define FLASH_EVENTLOG_START      0x00087000LU
+#define FLASH_EVENTLOG_NB_SECTORS 8
+
+// Sector erased and programmed by Flash_Benchmark
+#define FLASH_SCRATCH_START 0x0008F000LU
+
+// Flash geometry
+#define FLASH_SECTOR_SIZE 0x1000LU
+#define FLASH_PHRASE_SIZE 8
+#define FLASH_DATA_SIZE   (FLASH_DATA_END - FLASH_DATA_START + 1)
+#define FLASH_NB_PHRASES  (FLASH_DATA_SIZE / FLASH_PHRASE_SIZE)
+
+// Number of OS ticks the Flash thread waits after the first dirty write, so that further writes coalesce into one commit
+#define FLASH_COMMIT_DELAY 100
+
+// RAM shadow of the Flash data block - all non-volatile variables are read from and written to here
+extern volatile uint64_t FlashShadow[FLASH_NB_PHRASES];
+
+// Address of the start of the RAM shadow, the counterpart of FLASH_DATA_START
+#define FLASH_SHADOW_START ((uint32_t)(uintptr_t)FlashShadow)
+
+// FTFE command codes
+#define FLASH_CMD_PROGRAM_PHRASE  0x07
+#define FLASH_CMD_ERASE_SECTOR    0x09
+#define FLASH_CMD_PROGRAM_SECTION 0x0B
+
+// Most phrases written by one Program Section command, limited by the programming acceleration RAM
+#define FLASH_SECTION_MAX_PHRASES (FLASH_SECTOR_SIZE / FLASH_PHRASE_SIZE)
+
+/*!
+ * @struct TFlashCommand
+ */
+typedef struct FlashCommand
+{
+  uint8_t  command;                  /*!< FTFE command code, one of FLASH_CMD_... */
+  uint32_t address;                  /*!< Address of the phrase, sector or section the command acts on */
+  uint64_t phrase;                   /*!< Value to program with FLASH_CMD_PROGRAM_PHRASE */
+  const uint64_t* data;              /*!< Phrases to program with FLASH_CMD_PROGRAM_SECTION */
+  uint16_t nbPhrases;                /*!< Number of phrases in data, the section must not cross a sector boundary */
+  void (*completeCallback)(void*);   /*!< Called from the FTFE ISR when the command completes, may be NULL */
+  void* completeArguments;           /*!< Passed to completeCallback */
+  volatile bool complete;            /*!< Set by the ISR when the command has completed */
+  bool success;                      /*!< TRUE if the command completed without an error */
+  uint32_t cycles;                   /*!< Core clock cycles from launch to completion */
+  struct FlashCommand* next;         /*!< Private to the command queue */
+} TFlashCommand;
+
+/*!
+ * @struct TFlashStats
+ */
+typedef struct
+{
+  uint32_t NbErases;             /*!< Sector erases performed */
+  uint32_t NbErasesSaved;        /*!< Commits of the data block that were programmed in place without an erase */
+  uint32_t NbPhrasesProgrammed;  /*!< Phrase programs performed */
+  uint32_t NbPhrasesSkipped;     /*!< Phrase writes skipped because Flash already held the value */
+  uint32_t LastEraseCycles;      /*!< Core clock cycles taken by the last sector erase */
+  uint32_t MaxEraseCycles;       /*!< Core clock cycles taken by the slowest sector erase */
+  uint32_t LastProgramCycles;    /*!< Core clock cycles taken by the last phrase program */
+  uint32_t MaxProgramCycles;     /*!< Core clock cycles taken by the slowest phrase program */
+  uint32_t NbSectionsProgrammed; /*!< Program Section commands performed, their phrases are in NbPhrasesProgrammed */
+  uint32_t LastSectionCycles;    /*!< Core clock cycles taken by the last Program Section command */
+} TFlashStats;
+
 /*! @brief Enables the Flash module.
  *
+ *  Loads the RAM shadow from the Flash data block, enables the FTFE command complete interrupt
+ *  and creates the thread that lazily commits the shadow.
  *  @return bool - TRUE if the Flash was setup successfully.
+ *  @note Assumes the timestamp has been initialized, its cycle counter times each command.
  */
 bool Flash_Init(void);
  
 /*! @brief Allocates space for a non-volatile variable in the Flash memory.
  *
  *  @param variable is the address of a pointer to a variable that is to be allocated space in Flash memory.
- *         The pointer will be allocated to a relevant address:
+ *         The pointer will be allocated to a relevant address in the RAM shadow of the Flash data block:
  *         If the variable is a byte, then any address.
  *         If the variable is a half-word, then an even address.
  *         If the variable is a word, then an address divisible by 4.
@@ -48,50 +128,126 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size);
 
 /*! @brief Writes a 32-bit number to Flash.
  *
- *  @param address The address of the data.
+ *  The write is absorbed by the RAM shadow and committed to Flash later by the Flash thread or Flash_Sync.
+ *  @param address The address of the data in the RAM shadow.
  *  @param data The 32-bit data to write.
- *  @return bool - TRUE if Flash was written successfully, FALSE if address is not aligned to a 4-byte boundary or if there is a programming error.
- *  @note Assumes Flash has been initialized.
+ *  @return bool - TRUE if the shadow was written successfully, FALSE if address is not aligned to a 4-byte boundary or is outside the shadow.
+ *  @note Assumes Flash has been initialized. Safe to call from an ISR.
  */
 bool Flash_Write32(volatile uint32_t* const address, const uint32_t data);
  
 /*! @brief Writes a 16-bit number to Flash.
  *
- *  @param address The address of the data.
+ *  The write is absorbed by the RAM shadow and committed to Flash later by the Flash thread or Flash_Sync.
+ *  @param address The address of the data in the RAM shadow.
  *  @param data The 16-bit data to write.
- *  @return bool - TRUE if Flash was written successfully, FALSE if address is not aligned to a 2-byte boundary or if there is a programming error.
- *  @note Assumes Flash has been initialized.
+ *  @return bool - TRUE if the shadow was written successfully, FALSE if address is not aligned to a 2-byte boundary or is outside the shadow.
+ *  @note Assumes Flash has been initialized. Safe to call from an ISR.
  */
 bool Flash_Write16(volatile uint16_t* const address, const uint16_t data);
 
 /*! @brief Writes an 8-bit number to Flash.
  *
- *  @param address The address of the data.
+ *  The write is absorbed by the RAM shadow and committed to Flash later by the Flash thread or Flash_Sync.
+ *  @param address The address of the data in the RAM shadow.
  *  @param data The 8-bit data to write.
- *  @return bool - TRUE if Flash was written successfully, FALSE if there is a programming error.
- *  @note Assumes Flash has been initialized.
+ *  @return bool - TRUE if the shadow was written successfully, FALSE if address is outside the shadow.
+ *  @note Assumes Flash has been initialized. Safe to call from an ISR.
  */
 bool Flash_Write8(volatile uint8_t* const address, const uint8_t data);
 
+/*! @brief Commits any dirty phrases of the RAM shadow to Flash.
+ *
+ *  Used for critical fields which must be in Flash before the write is acknowledged.
+ *  @return bool - TRUE if the shadow and Flash agree on return.
+ *  @note Assumes Flash has been initialized. Must not be called from an ISR.
+ */
+bool Flash_Sync(void);
+
 /*! @brief Erases the entire Flash sector.
  *
  *  @return bool - TRUE if the Flash "data" sector was erased successfully.
- *  @note Assumes Flash has been initialized.
+ *  @note Assumes Flash has been initialized. Must not be called from an ISR.
  */
 bool Flash_Erase(void);
 
-/*! @brief Writes the number of lowers.
+/*! @brief Programs one phrase anywhere in Flash.
  *
- *  @return true if successfully written.
- *  @note Assumes Flash has been initialized.
+ *  @param address The address of the phrase, aligned to an 8-byte boundary.
+ *  @param phrase The value of the phrase being written.
+ *  @return bool - TRUE if the phrase was programmed successfully or already held the value,
+ *                 FALSE if the phrase is not erased (it has already been programmed) or if there is a programming error.
+ *  @note Assumes Flash has been initialized. Must not be called from an ISR.
+ */
+bool Flash_ProgramPhrase(const uint32_t address, const uint64_t phrase);
+
+/*! @brief Programs consecutive phrases using the Program Section command.
+ *
+ *  The data is staged in the programming acceleration RAM, so one command writes up to a sector at a time.
+ *  @param address The address of the first phrase, aligned to an 8-byte boundary.
+ *  @param data The phrases to write.
+ *  @param nbPhrases The number of phrases to write.
+ *  @return bool - TRUE if every phrase was programmed successfully.
+ *  @note Assumes Flash has been initialized and the destination is erased. Must not be called from an ISR.
+ */
+bool Flash_ProgramSection(const uint32_t address, const uint64_t data[], const uint16_t nbPhrases);
+
+/*! @brief Measures the rate at which a sector is written one phrase at a time and one section at a time.
+ *
+ *  Uses the scratch sector at FLASH_SCRATCH_START, which is left erased.
+ *  @param phraseRate Where the rate using Program Phrase, in bytes per second, is to be written.
+ *  @param sectionRate Where the rate using Program Section, in bytes per second, is to be written.
+ *  @return bool - TRUE if the benchmark completed.
+ *  @note Assumes Flash has been initialized. Must not be called from an ISR.
+ */
+bool Flash_Benchmark(uint32_t* const phraseRate, uint32_t* const sectionRate);
+
+/*! @brief Reads one phrase from Flash.
+ *
+ *  Waits for any erase or program started by another thread, since Flash cannot be read while it is busy.
+ *  @param address The address of the phrase, aligned to an 8-byte boundary.
+ *  @param phrase Where the phrase is to be read to.
+ *  @return bool - TRUE if the phrase was read.
+ *  @note Assumes Flash has been initialized. Must not be called from an ISR.
+ */
+bool Flash_ReadPhrase(const uint32_t address, uint64_t* const phrase);
+
+/*! @brief Erases one sector anywhere in Flash.
+ *
+ *  @param address The address of the first byte of the sector.
+ *  @return bool - TRUE if the sector was erased successfully.
+ *  @note Assumes Flash has been initialized. Must not be called from an ISR.
+ */
+bool Flash_EraseSector(const uint32_t address);
+
+/*! @brief Queues a command for the FTFE without waiting for it to complete.
+ *
+ *  Commands are executed in the order they are submitted. On completion the ISR fills in success and cycles,
+ *  sets complete and calls completeCallback.
+ *  @param command A pointer to the command, which must stay valid until it completes.
+ *  @return bool - TRUE if the command was queued, FALSE if the command code is not supported.
+ *  @note Assumes Flash has been initialized. Safe to call from an ISR.
+ *        Nothing in the Flash block being erased or programmed may be read until the command completes,
+ *        a read anywhere in that block is a read collision. The counter, configuration and event log share block 1.
+ *        A command on block 0 is executed from RAM with interrupts disabled, since no code can be fetched until it completes.
+ */
+bool Flash_Submit(TFlashCommand* const command);
+
+/*! @brief Gets the erase and program statistics since power up or the last Flash_ResetStats.
+ *
+ *  @param stats A pointer to where the statistics are to be copied.
+ */
+void Flash_GetStats(TFlashStats* const stats);
+
+/*! @brief Clears the erase and program statistics, so that the next Flash_GetStats covers only what follows.
  */
-bool Flash_NbLowers(void);
+void Flash_ResetStats(void);
 
-/*! @brief Writes the number of raises.
+/*! @brief Interrupt service routine for the FTFE command complete.
  *
- *  @return true if successfully written.
+ *  Completes the command at the head of the queue and launches the next one.
  *  @note Assumes Flash has been initialized.
  */
-bool Flash_NbRaises(void);
+void __attribute__ ((interrupt)) FTFE_ISR(void);
 
 #endif
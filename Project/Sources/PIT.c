@@ -16,8 +16,61 @@
 #include "brOS.h"
 
 // Macros
-#define MODULE_CLK_PERIOD_NANOSECONDS 47                                                              // For macro function integer calculation. Too big for uint32_t
-#define LDVAL_CALC(DESIRED_PERIOD)  (uint32_t)((DESIRED_PERIOD)/(MODULE_CLK_PERIOD_NANOSECONDS) - 1)  // Macro function for PIT load value calculation
+#define NANOSECONDS_PER_SECOND 1000000000LU
+#define PIT_IRQ_SHIFT 4  // PIT channel 0 is IRQ 68, 68 % 32 == 4, the other channels follow on in NVIC register 2
+
+typedef struct
+{
+  TPITMode mode;
+  void (*userFunction)(void*);
+  void* userArguments;
+  uint32_t cycles;       // Whole module clock cycles in the period
+  uint32_t fraction;     // Fraction of a cycle in the period, in billionths
+  uint32_t accumulator;  // Fractions carried so far, a whole cycle is added to a period when it overflows
+} TPITChannel;
+
+// Private global variables
+static TPITChannel Channels[PIT_NB_CHANNELS];
+static uint32_t ModuleClk;
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Gets the load value for the next period of a channel.
+ *
+ *  The period alternates between N and N + 1 cycles so that, on average, it is exactly the period that was set.
+ *  @param channel - The channel.
+ *  @return uint32_t - The value to write to LDVAL.
+ */
+static uint32_t NextLoadValue(TPITChannel* const channel)
+{
+  uint32_t cycles = channel->cycles;
+
+  channel->accumulator += channel->fraction;
+  if (channel->accumulator >= NANOSECONDS_PER_SECOND)
+  {
+    channel->accumulator -= NANOSECONDS_PER_SECOND;
+    cycles++;
+  }
+
+  return cycles - 1;  // The timer counts down to 0 inclusive
+}
+
+/*! @brief Handles a time-out of a PIT channel.
+ *
+ *  @param channel - The channel that has timed out.
+ */
+static void Dispatch(const uint8_t channel)
+{
+  PIT_TFLG(channel) = PIT_TFLG_TIF_MASK;  // Clear flag by w1c
+
+  if (Channels[channel].mode == PIT_MODE_ONE_SHOT)
+    PIT_TCTRL(channel) &= ~PIT_TCTRL_TEN_MASK;
+  else if (Channels[channel].fraction)
+    PIT_LDVAL(channel) = NextLoadValue(&Channels[channel]);  // The timer has already reloaded, so this is for the period after next
+
+  if (Channels[channel].userFunction)
+    (*Channels[channel].userFunction)(Channels[channel].userArguments);
+}
 
 // PUBLIC FUNCTIONS
 
@@ -26,215 +79,128 @@ bool PIT_Init(const uint32_t moduleClk)
   // Following example in K70 Ref Manual pg 1340
   SIM_SCGC6 |= SIM_SCGC6_PIT_MASK;  // Enable the clock to the PIT (all channels)
 
+  ModuleClk = moduleClk;
+
   PIT_MCR = ~PIT_MCR_MDIS_MASK;     // Enable the PIT, making MDIS 0 so that PIT can be used (this must be done first)
   PIT_MCR |= PIT_MCR_FRZ_MASK;      // Also enable the FRZ register to freeze PIT timers during debug mode.
 
-  PIT_TCTRL0 |= PIT_TCTRL_TIE_MASK; // Set arm bit (enable timer 0 interrupts by writing 1 to TIE [timer interrupt enable] register)
-  PIT_TCTRL1 |= PIT_TCTRL_TIE_MASK;
+  // Channels stay stopped and silent until they are registered
+  for (uint8_t channel = 0; channel < PIT_NB_CHANNELS; channel++)
+  {
+    PIT_TCTRL(channel) = 0;
+    PIT_TFLG(channel) = PIT_TFLG_TIF_MASK;
+    Channels[channel].userFunction = NULL;
+  }
 
-  // FIXME: Re-enable interrupts for PIT channel 3 and 4 later, if necessary.
-//  PIT_TCTRL2 |= PIT_TCTRL_TIE_MASK;
-//  PIT_TCTRL3 |= PIT_TCTRL_TIE_MASK;
+  return true;
+}
 
-  // PIT Channel 0 Interrupts
-  // Set NVIC bits
-  // IRQ = 68
-  // NVIC non-IPR=2, IPR=17
-  // Clear any pending interrupts on PIT timer0
-  // Left shift == IRQ % 32 == 68 % 32 == 4
-  NVICICPR2 = (1 << 4);
-  NVICISER2 = (1 << 4);
+bool PIT_Register(const uint8_t channel, const TPITMode mode, void (*userFunction)(void*), void* userArguments)
+{
+  if (channel >= PIT_NB_CHANNELS)
+    return false;
+
+  EnterCritical();
+  Channels[channel].mode          = mode;
+  Channels[channel].userFunction  = userFunction;
+  Channels[channel].userArguments = userArguments;
+  ExitCritical();
+
+  PIT_TCTRL(channel) |= PIT_TCTRL_TIE_MASK; // Set arm bit (enable timer interrupts by writing 1 to TIE [timer interrupt enable] register)
 
-  // PIT Channel 1 Interrupts
   // Set NVIC bits
-  // IRQ = 69
+  // IRQ = 68 + channel
   // NVIC non-IPR=2, IPR=17
-  // Clear any pending interrupts on PIT timer0
-  // Left shift == IRQ % 32 == 69 % 32 == 5
-  NVICICPR2 = (1 << 5);
-  NVICISER2 = (1 << 5);
-
+  // Clear any pending interrupts on the channel, then enable them
+  NVICICPR2 = (1 << (PIT_IRQ_SHIFT + channel));
+  NVICISER2 = (1 << (PIT_IRQ_SHIFT + channel));
 
   return true;
 }
 
-void PIT_Set(const uint32_t period, const bool restart, uint8_t channel)
+void PIT_Set(const uint32_t period, const bool restart, const uint8_t channel)
 {
+  if (channel >= PIT_NB_CHANNELS)
+    return;
+
+  // Period in cycles of the real module clock, split into whole cycles and billionths of a cycle
+  uint64_t cycles = (uint64_t)period * ModuleClk;
+  TPITChannel* const pit = &Channels[channel];
+
+  EnterCritical();
+  pit->cycles = (uint32_t)(cycles / NANOSECONDS_PER_SECOND);
+  pit->fraction = (uint32_t)(cycles % NANOSECONDS_PER_SECOND);
+
+  // Carry the part of a cycle owed so far into the new period, unless the timer starts again from now
+  if (restart)
+    pit->accumulator = 0;
 
-  switch(channel)
+  // A one-shot times out once, so the nearest whole cycle is as close as it gets
+  if (pit->mode == PIT_MODE_ONE_SHOT)
   {
-    // Channel 0
-    case (0):
-      if (restart)
-      {
-        PIT_Enable(false, 0);                // Stop the PIT
-        PIT_LDVAL0 = LDVAL_CALC(period);  // New value
-        PIT_Enable(true, 0);                 // Restart the PIT
-      }
-      else
-      {
-        // Loading the value lets the current timer finish,
-        // after the PIT interrupt, a new timer with the new value will begin
-        PIT_LDVAL0 = LDVAL_CALC(period);
-      }
-      break;
-
-    // Channel 1
-    case (1):
-      if (restart)
-      {
-        PIT_Enable(false, 1);                // Stop the PIT
-        PIT_LDVAL1 = LDVAL_CALC(period);  // New value
-        PIT_Enable(true, 1);                 // Restart the PIT
-      }
-      else
-      {
-        // Loading the value lets the current timer finish,
-        // after the PIT interrupt, a new timer with the new value will begin
-        PIT_LDVAL1 = LDVAL_CALC(period);
-      }
-      break;
-
-    // Channel 2
-    case (2):
-      if (restart)
-      {
-        PIT_Enable(false, 2);                // Stop the PIT
-        PIT_LDVAL2 = LDVAL_CALC(period);  // New value
-        PIT_Enable(true, 2);                 // Restart the PIT
-      }
-      else
-      {
-        // Loading the value lets the current timer finish,
-        // after the PIT interrupt, a new timer with the new value will begin
-        PIT_LDVAL2 = LDVAL_CALC(period);
-      }
-      break;
-
-    // Channel 3
-    case (3):
-      if (restart)
-      {
-        PIT_Enable(false, 3);                // Stop the PIT
-        PIT_LDVAL3 = LDVAL_CALC(period);  // New value
-        PIT_Enable(true, 3);                 // Restart the PIT
-      }
-      else
-      {
-        // Loading the value lets the current timer finish,
-        // after the PIT interrupt, a new timer with the new value will begin
-        PIT_LDVAL3 = LDVAL_CALC(period);
-      }
-      break;
-
-    default:
-      break;
+    if (pit->fraction >= NANOSECONDS_PER_SECOND / 2)
+      pit->cycles++;
+    pit->fraction = 0;
   }
-}
 
-void PIT_Enable(const bool enable, uint8_t channel)
-{
-  // Act on MDIS (Module Disable) 1 - Stop all timers, 0 - Enable all timers
+  if (pit->cycles == 0)
+    pit->cycles = 1;
 
-  switch(channel)
+  if (restart)
   {
-    // Channel 0
-    case (0):
-      if (enable)
-        PIT_TCTRL0 |= PIT_TCTRL_TEN_MASK;   // Start timer 0 by writing 1 to TEN (timer enable)
-      else
-        PIT_TCTRL0 &= ~PIT_TCTRL_TEN_MASK;  // Stop timer 0 by writing 1 to TEN (timer enable)
-      break;
-
-    // Channel 1
-    case (1):
-      if (enable)
-        PIT_TCTRL1 |= PIT_TCTRL_TEN_MASK;   // Start timer 0 by writing 1 to TEN (timer enable)
-      else
-        PIT_TCTRL1 &= ~PIT_TCTRL_TEN_MASK;  // Stop timer 0 by writing 1 to TEN (timer enable)
-      break;
-
-    // Channel 2
-    case (2):
-      if (enable)
-        PIT_TCTRL2 |= PIT_TCTRL_TEN_MASK;   // Start timer 0 by writing 1 to TEN (timer enable)
-      else
-        PIT_TCTRL2 &= ~PIT_TCTRL_TEN_MASK;  // Stop timer 0 by writing 1 to TEN (timer enable)
-      break;
-
-    // Channel 3
-    case (3):
-      if (enable)
-        PIT_TCTRL3 |= PIT_TCTRL_TEN_MASK;   // Start timer 0 by writing 1 to TEN (timer enable)
-      else
-        PIT_TCTRL3 &= ~PIT_TCTRL_TEN_MASK;  // Stop timer 0 by writing 1 to TEN (timer enable)
-      break;
+    PIT_Enable(false, channel);                 // Stop the PIT
+    PIT_LDVAL(channel) = NextLoadValue(pit);    // New value
+    PIT_Enable(true, channel);                  // Restart the PIT
+
+    // LDVAL only takes effect at the next reload, so the period after the first can be queued now
+    if (pit->fraction)
+      PIT_LDVAL(channel) = NextLoadValue(pit);
   }
+  else
+  {
+    // Loading the value lets the current timer finish,
+    // after the PIT interrupt, a new timer with the new value will begin
+    PIT_LDVAL(channel) = NextLoadValue(pit);
+  }
+  ExitCritical();
 }
 
-// Sampling PIT
-void __attribute__ ((interrupt)) PIT0_ISR(void)
+void PIT_Enable(const bool enable, const uint8_t channel)
 {
-  OS_ISREnter();
-
-  PIT_TFLG0 |= PIT_TFLG_TIF_MASK;    // Clear flag by w1c
+  if (channel >= PIT_NB_CHANNELS)
+    return;
 
-  // TODO: Remove the three separate counters, they'll always be sampled at the same time, hence the counters will always be equal.
-  Analog_Get(CHANNEL_A, &NewestPhaseA);
-  PhaseA.Counter++;
-  Analog_Get(CHANNEL_B, &NewestPhaseB);
-  PhaseB.Counter++;
-  Analog_Get(CHANNEL_C, &NewestPhaseC);
-  PhaseC.Counter++;
+  if (enable)
+    PIT_TCTRL(channel) |= PIT_TCTRL_TEN_MASK;   // Start the timer by writing 1 to TEN (timer enable)
+  else
+    PIT_TCTRL(channel) &= ~PIT_TCTRL_TEN_MASK;  // Stop the timer by writing 0 to TEN (timer enable)
+}
 
-  if (PhaseA.Counter >= 16 || PhaseB.Counter >= 16 || PhaseC.Counter >= 16  )
-  {
-    if (PhaseA.Counter >= NB_SAMPLES)
-    {
-      PhaseA.Counter -= 16;
-    }
-    if (PhaseB.Counter >= NB_SAMPLES)
-    {
-      PhaseB.Counter -= 16;
-    }
-    if (PhaseC.Counter >= NB_SAMPLES)
-    {
-      PhaseC.Counter -= 16;
-    }
-    OS_SemaphoreSignal(SampleComplete);
-  }
+void __attribute__ ((interrupt)) PIT0_ISR(void)
+{
+  OS_ISREnter();
+  Dispatch(0);
   OS_ISRExit();
 }
 
-// StopWatch Timer
 void __attribute__ ((interrupt)) PIT1_ISR(void)
 {
   OS_ISREnter();
+  Dispatch(1);
+  OS_ISRExit();
+}
 
-  PIT_TFLG1 |= PIT_TFLG_TIF_MASK;    // Clear flag by w1c
-
-  // Only increment the stopwatch if we want to be timing for an alarm
-  if (AlarmStopWatch.SetLevel != NOT_SET)
-  {
-    AlarmStopWatch.StopWatch++;
-
-    // If we've reached the stop-watch limit (with wiggle-room), output the alarm.
-    if ((AlarmStopWatch.StopWatch >= AlarmStopWatch.StopWatchStop) && (AlarmStopWatch.StopWatch < AlarmStopWatch.StopWatchStop + 10))
-    {
-      switch (AlarmStopWatch.SetLevel)
-      {
-        case (SET_HIGH):
-          Logic_OutputLower(ON);
-          AlarmStopWatch.StopWatch = 0;
-          break;
-        case (SET_LOW):
-          Logic_OutputRaise(ON);
-          AlarmStopWatch.StopWatch = 0;
-          break;
-      }
-    }
-  }
+void __attribute__ ((interrupt)) PIT2_ISR(void)
+{
+  OS_ISREnter();
+  Dispatch(2);
+  OS_ISRExit();
+}
 
+void __attribute__ ((interrupt)) PIT3_ISR(void)
+{
+  OS_ISREnter();
+  Dispatch(3);
   OS_ISRExit();
 }
 
@@ -11,56 +11,67 @@
 #ifndef PIT_H
 #define PIT_H
 
+#define PIT_NB_CHANNELS   4
 #define SAMPLING_CHANNEL  0
-#define STOPWATCH_CHANNEL 1
-#define INVERSE_TIMING    2
+#define DEADLINE_CHANNEL  1
+#define WHEEL_CHANNEL     2
+#define TIME_CHANNEL      3
 
 // new types
 #include "types.h"
 
+typedef enum
+{
+  PIT_MODE_PERIODIC,  /*!< The channel reloads and calls back every period */
+  PIT_MODE_ONE_SHOT   /*!< The channel stops after calling back once */
+} TPITMode;
+
 /*! @brief Sets up the PIT before first use.
  *
  *  Enables the PIT and freezes the timer when debugging.
- *  @param moduleClk The module clock rate in Hz.
- *  @param userFunction is a pointer to a user callback function.
- *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @param moduleClk The module clock rate in Hz, from which all periods are calculated.
  *  @return bool - TRUE if the PIT was successfully initialized.
- *  @note Assumes that moduleClk has a period which can be expressed as an integral number of nanoseconds.
  */
 bool PIT_Init(const uint32_t moduleClk);
 
+/*! @brief Registers the user callback of a PIT channel and enables its interrupts.
+ *
+ *  @param channel - Which PIT channel to set up.
+ *  @param mode - PIT_MODE_PERIODIC or PIT_MODE_ONE_SHOT.
+ *  @param userFunction is a pointer to a user callback function, called from the channel's ISR.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @return bool - TRUE if the channel was set up successfully.
+ *  @note A one-shot channel is started again with PIT_Set or PIT_Enable, which may be called from the callback.
+ */
+bool PIT_Register(const uint8_t channel, const TPITMode mode, void (*userFunction)(void*), void* userArguments);
+
 /*! @brief Sets the value of the desired period of the PIT.
  *
  *  @param period The desired value of the timer period in nanoseconds.
  *  @param restart TRUE if the PIT is disabled, a new value set, and then enabled.
  *                 FALSE if the PIT will use the new value after a trigger event.
  *  @param channel - Which PIT channel to set.
- *  @note The function will enable the timer and interrupts for the PIT.
+ *  @note A periodic channel alternates between the two nearest whole numbers of module clock cycles,
+ *        so that over many periods it keeps exactly to the period set.
  */
-void PIT_Set(const uint32_t period, const bool restart, uint8_t channel);
+void PIT_Set(const uint32_t period, const bool restart, const uint8_t channel);
 
 /*! @brief Enables or disables the PIT.
  *
  *  @param enable - TRUE if the PIT is to be enabled, FALSE if the PIT is to be disabled.
  *  @param channel - Which PIT channel to enable.
  */
-void PIT_Enable(const bool enable, uint8_t channel);
+void PIT_Enable(const bool enable, const uint8_t channel);
 
-/*! @brief Interrupt service routine for the PIT.
+/*! @brief Interrupt service routines for the PIT channels.
  *
  *  The periodic interrupt timer has timed out.
- *  The sampling will now occur.
+ *  The user callback function registered for the channel will be called.
  *  @note Assumes the PIT has been initialized.
  */
 void __attribute__ ((interrupt)) PIT0_ISR(void);
-
-/*! @brief Interrupt service routine for the PIT.
- *
- *  The periodic interrupt timer has timed out.
- *  The AlarmStopWatch object will have its StopWatch attribute
- *  incremented if the Alarm is set.
- *  @note Assumes the PIT has been initialized.
- */
 void __attribute__ ((interrupt)) PIT1_ISR(void);
+void __attribute__ ((interrupt)) PIT2_ISR(void);
+void __attribute__ ((interrupt)) PIT3_ISR(void);
 
 #endif
@@ -19,65 +19,311 @@
 // Externs
 extern OS_ECB* OneSecond;
 
+// Start-up time of the 32 kHz oscillator, from the data sheet
+#define OSC_STARTUP_MS 1000
 
-// PUBLIC FUNCTIONS
+#define SECONDS_PER_DAY 86400
+#define MIN_YEAR 1970                 // The time seconds register counts from the start of this year
+#define MAX_YEAR 2105                 // The last whole year the time seconds register can hold
 
-bool RTC_Init(void)
+// Private global variables
+static volatile bool Ready;           // TRUE once the oscillator has settled and the time counter is running
+static TWheelTimer OscillatorTimer;   // Runs out once the oscillator has had time to settle
+static void (*AlarmFunction)(void*);  // Called when the alarm goes off
+static void* AlarmArguments;
+static volatile TRTCTime Cached;      // The date and time as of the last second
+static volatile uint32_t Sequence;    // Odd while the cached time is being written
+
+static const uint8_t DaysInMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Checks for a leap year.
+ *
+ *  @param year The year.
+ *  @return bool - TRUE if February has 29 days.
+ */
+static bool IsLeapYear(const uint16_t year)
 {
-  SIM_SCGC6 |= SIM_SCGC6_RTC_MASK;     // Enable clock gate
+  return ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+}
 
-  RTC_CR |= RTC_CR_SC2P_MASK;          // Enable 2pF capacitor
-  RTC_CR |= RTC_CR_SC16P_MASK;         // Enable 16pF capacitor
+/*! @brief Counts the days from 1970-01-01 to a date.
+ *
+ *  Counts in years that start in March, so the leap day falls at the end of the year.
+ *  @param year The year (1970-2105).
+ *  @param month The month (1-12).
+ *  @param day The day of the month (1-31).
+ *  @return uint32_t - The number of days since 1970-01-01.
+ */
+static uint32_t DaysFromDate(uint16_t year, const uint8_t month, const uint8_t day)
+{
+  uint32_t era, yearOfEra, dayOfYear, dayOfEra;
 
-  RTC_IER |= RTC_IER_TSIE_MASK;        // Enable Time Seconds Interrupt
-  RTC_SR |= RTC_SR_TCE_MASK;           // Enable Time Counter (this will make the TSR and TPR registers increment but non-writable)
+  if (month <= 2)
+    year--;
 
-  RTC_CR |= RTC_CR_OSCE_MASK;          // Enable Oscillator
-  for (int i = 0; i < 0x600000; i++);  // Wait for oscillators to stabilize
+  era = year / 400;
+  yearOfEra = year - era*400;
+  dayOfYear = (153*(month > 2 ? month - 3 : month + 9) + 2)/5 + day - 1;
+  dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+
+  return era*146097 + dayOfEra - 719468;  // 719468 days from 0000-03-01 to 1970-01-01
+}
+
+/*! @brief Breaks a count of seconds since 1970-01-01 down into a date and time.
+ *
+ *  @param epoch The seconds since 1970-01-01 00:00:00.
+ *  @param time The address of a variable to store the date and time.
+ */
+static void BreakDown(const uint32_t epoch, TRTCTime* const time)
+{
+  uint32_t days = epoch / SECONDS_PER_DAY;
+  uint32_t secondOfDay = epoch % SECONDS_PER_DAY;
+  uint32_t era, dayOfEra, yearOfEra, dayOfYear, monthIndex;
+
+  time->epoch   = epoch;
+  time->hours   = secondOfDay / 3600;
+  time->minutes = (secondOfDay % 3600) / 60;
+  time->seconds = secondOfDay % 60;
+  time->weekday = (days + 4) % 7;      // 1970-01-01 was a Thursday
+
+  // The inverse of DaysFromDate
+  days += 719468;
+  era = days / 146097;
+  dayOfEra = days - era*146097;
+  yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096) / 365;
+  dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+  monthIndex = (5*dayOfYear + 2) / 153;
+
+  time->day   = dayOfYear - (153*monthIndex + 2)/5 + 1;
+  time->month = (monthIndex < 10) ? monthIndex + 3 : monthIndex - 9;
+  time->year  = yearOfEra + era*400 + (time->month <= 2);
+}
+
+/*! @brief Breaks the time seconds register down into the cached date and time.
+ *
+ *  @note Called from the RTC interrupt, or from a critical section, so there is only ever one writer.
+ */
+static void UpdateCache(void)
+{
+  TRTCTime time;
+
+  BreakDown(RTC_GetSeconds(), &time);
+
+  // Readers retry if the sequence is odd or has moved on while they were copying
+  Sequence++;
+  Cached = time;
+  Sequence++;
+}
 
+/*! @brief Writes the time seconds register.
+ *
+ *  @param epoch The seconds since 1970-01-01 00:00:00.
+ */
+static void WriteSeconds(const uint32_t epoch)
+{
+  EnterCritical();
+  RTC_SR &= ~RTC_SR_TCE_MASK;          // Disable Time Counter
+  RTC_TSR = epoch;
+  if (Ready)
+    RTC_SR |= RTC_SR_TCE_MASK;         // Enable Time Counter, unless the oscillator is still settling
+  UpdateCache();
+  ExitCritical();
+}
+
+/*! @brief Starts the time counter and the seconds interrupt, the second half of RTC_Init.
+ *
+ *  @param pData is not used but is required by the timer wheel callback.
+ *  @note Called once the oscillator has settled.
+ */
+static void StartCounter(void* pData)
+{
   if (RTC_SR & RTC_SR_TIF_MASK)
   {
-    RTC_Set(0,0,0);                    // If SR[TIF] is set, then reset timer, this will also clear the SR[TIF] flag
+    RTC_TSR = 0;                       // If SR[TIF] is set, then reset timer, this will also clear the SR[TIF] flag
   }
 
+  RTC_IER |= RTC_IER_TSIE_MASK;        // Enable Time Seconds Interrupt
+  RTC_SR |= RTC_SR_TCE_MASK;           // Enable Time Counter (this will make the TSR and TPR registers increment but non-writable)
+
   RTC_LR &= ~RTC_LR_CRL_MASK;          // Lock the control register
 
   NVICICPR2 = (1 << 3);                // Clear pending interrupts on the RTC timer
   NVICISER2 = (1 << 3);                // Enable RTC Interrupt Service Routine
 
-  return true;
+  RTC_IER &= ~RTC_IER_TAIE_MASK;       // No alarm until one is set
+  NVICICPR2 = (1 << 2);                // Clear pending interrupts on the RTC alarm (IRQ 66)
+  NVICISER2 = (1 << 2);                // Enable RTC alarm Interrupt Service Routine
+
+  EnterCritical();
+  UpdateCache();
+  ExitCritical();
+
+  Ready = true;
+}
+
+// PUBLIC FUNCTIONS
+
+bool RTC_Init(void)
+{
+  SIM_SCGC6 |= SIM_SCGC6_RTC_MASK;     // Enable clock gate
+  Ready = false;
+  UpdateCache();
+
+  // The oscillator keeps running on the battery across resets, then there is nothing to wait for
+  if (RTC_CR & RTC_CR_OSCE_MASK)
+  {
+    StartCounter(NULL);
+    return true;
+  }
+
+  RTC_CR |= RTC_CR_SC2P_MASK;          // Enable 2pF capacitor
+  RTC_CR |= RTC_CR_SC16P_MASK;         // Enable 16pF capacitor
+  RTC_CR |= RTC_CR_OSCE_MASK;          // Enable Oscillator
+
+  // Wait for the oscillator to stabilize in the background, the rest of the tower does not need it
+  return Wheel_Start(&OscillatorTimer, WHEEL_MS_TO_TICKS(OSC_STARTUP_MS), 0, WHEEL_CONTEXT_ISR, StartCounter, NULL);
+}
+
+
+bool RTC_IsReady(void)
+{
+  return Ready;
 }
 
 
 void RTC_Set(const uint8_t hours, const uint8_t minutes, const uint8_t seconds)
 {
+  uint32_t midnight = RTC_GetSeconds() / SECONDS_PER_DAY * SECONDS_PER_DAY;
 
-  RTC_SR &= ~RTC_SR_TCE_MASK;                                                 // Disable Time Counter
-  RTC_TSR = (uint32_t)seconds + (uint32_t)minutes*60 + (uint32_t)hours*3600;  // Assign total time in seconds to Time Seconds Register
-  RTC_SR |= RTC_SR_TCE_MASK;                                                  // Enable Time Counter
+  WriteSeconds(midnight + (uint32_t)seconds + (uint32_t)minutes*60 + (uint32_t)hours*3600);
 }
 
 
 void RTC_Get(uint8_t* const hours, uint8_t* const minutes, uint8_t* const seconds)
 {
-  // Reset time to 0 when it goes past 23h 59m 59s
-  uint32_t totalTimeSeconds = RTC_TSR % 86400;
+  TRTCTime time;
+
+  RTC_GetTime(&time);
+
+  *hours = time.hours;
+  *minutes = time.minutes;
+  *seconds = time.seconds;
+}
+
+
+bool RTC_SetDate(const uint16_t year, const uint8_t month, const uint8_t day)
+{
+  if ((year < MIN_YEAR) || (year > MAX_YEAR) || (month < 1) || (month > 12) || (day < 1))
+    return false;
+
+  if (day > DaysInMonth[month - 1] + ((month == 2) && IsLeapYear(year)))
+    return false;
+
+  WriteSeconds(DaysFromDate(year, month, day)*SECONDS_PER_DAY + RTC_GetSeconds() % SECONDS_PER_DAY);
+  return true;
+}
+
+
+void RTC_GetTime(TRTCTime* const time)
+{
+  uint32_t sequence;
+
+  do
+  {
+    sequence = Sequence;
+    *time = Cached;
+  } while ((sequence & 1) || (sequence != Sequence));
+}
+
+
+uint32_t RTC_GetEpoch(void)
+{
+  return Cached.epoch;
+}
+
+
+uint32_t RTC_GetSeconds(void)
+{
+  uint32_t seconds;
 
   // Time-seconds register can give an inaccurate read, so read twice and make sure they're the same value
   do
   {
-    totalTimeSeconds = RTC_TSR;
-  } while(totalTimeSeconds != RTC_TSR);
+    seconds = RTC_TSR;
+  } while (seconds != RTC_TSR);
+
+  return seconds;
+}
+
+
+void RTC_GetTimestamp(TRTCTimestamp* const timestamp)
+{
+  uint32_t seconds;
+  uint32_t prescaler;
+
+  // Both registers can give an inaccurate read, and the prescaler wrapping moves the seconds on,
+  // so read until the prescaler reads the same twice within one value of the seconds
+  do
+  {
+    seconds = RTC_TSR;
+    do
+    {
+      prescaler = RTC_TPR;
+    } while (prescaler != RTC_TPR);
+  } while (seconds != RTC_TSR);
+
+  timestamp->seconds = seconds;
+  timestamp->fraction = (uint16_t)(prescaler & (RTC_FRACTIONS_PER_SECOND - 1));
+}
+
+
+bool RTC_SetAlarm(const uint32_t seconds, void (*userFunction)(void*), void* userArguments)
+{
+  if (!Ready || (seconds <= RTC_GetSeconds()))
+    return false;
+
+  EnterCritical();
+  AlarmFunction = userFunction;
+  AlarmArguments = userArguments;
 
-  *hours = (totalTimeSeconds/3600);
-  *minutes = (totalTimeSeconds % 3600) / 60;
-  *seconds = totalTimeSeconds - (*hours)*3600 - (*minutes)*60;
+  // The alarm flag sets as the seconds register counts on from the alarm register, writing it clears an old flag
+  RTC_TAR = seconds - 1;
+  RTC_IER |= RTC_IER_TAIE_MASK;
+  ExitCritical();
+
+  return true;
+}
+
+
+void RTC_CancelAlarm(void)
+{
+  EnterCritical();
+  RTC_IER &= ~RTC_IER_TAIE_MASK;
+  AlarmFunction = NULL;
+  ExitCritical();
+}
+
+
+void __attribute__ ((interrupt)) RTC_AlarmISR(void)
+{
+  OS_ISREnter();
+
+  RTC_IER &= ~RTC_IER_TAIE_MASK;       // The alarm goes off once
+  RTC_TAR = 0;                         // Clear the alarm flag by writing the alarm register
+
+  if (AlarmFunction)
+    (*AlarmFunction)(AlarmArguments);
+
+  OS_ISRExit();
 }
 
 
 void __attribute__ ((interrupt)) RTC_ISR(void)
 {
   OS_ISREnter();
+  UpdateCache();
   OS_SemaphoreSignal(OneSecond);
   OS_ISRExit();
 }
@@ -14,22 +14,54 @@
 // new types
 #include "types.h"
 
+// Rate of the prescaler, the fraction of a timestamp is in these units
+#define RTC_FRACTIONS_PER_SECOND 32768
+
+/*!
+ * @struct TRTCTimestamp
+ */
+typedef struct
+{
+  uint32_t seconds;   /*!< Value of the time seconds register */
+  uint16_t fraction;  /*!< Fraction of the second in 1/32768 s, from the time prescaler register */
+} TRTCTimestamp;
+
+/*!
+ * @struct TRTCTime
+ */
+typedef struct
+{
+  uint32_t epoch;    /*!< Seconds since 1970-01-01 00:00:00, the value of the time seconds register */
+  uint16_t year;     /*!< Year (1970-2105) */
+  uint8_t  month;    /*!< Month (1-12) */
+  uint8_t  day;      /*!< Day of the month (1-31) */
+  uint8_t  weekday;  /*!< Day of the week (0-6), 0 is Sunday */
+  uint8_t  hours;    /*!< Hours (0-23) */
+  uint8_t  minutes;  /*!< Minutes (0-59) */
+  uint8_t  seconds;  /*!< Seconds (0-59) */
+} TRTCTime;
+
 /*! @brief Initializes the RTC before first use.
  *
- *  Sets up the control register for the RTC and locks it.
- *  Enables the RTC and sets an interrupt every second.
- *  @param userFunction is a pointer to a user callback function.
- *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  Sets up the control register for the RTC and starts the oscillator without waiting for it.
+ *  Once the oscillator has settled, the RTC is enabled, the control register locked and an interrupt set every second.
  *  @return bool - TRUE if the RTC was successfully initialized.
+ *  @note Assumes the timer wheel has been initialized.
  */
 bool RTC_Init(void);
 
+/*! @brief Checks whether the RTC is counting.
+ *
+ *  @return bool - TRUE once the oscillator has settled and the time counter is running.
+ */
+bool RTC_IsReady(void);
+
 /*! @brief Sets the value of the real time clock.
  *
  *  @param hours The desired value of the real time clock hours (0-23).
  *  @param minutes The desired value of the real time clock minutes (0-59).
  *  @param seconds The desired value of the real time clock seconds (0-59).
- *  @note Assumes that the RTC module has been initialized and all input parameters are in range.
+ *  @note Assumes that the RTC module has been initialized and all input parameters are in range. The date is kept.
  */
 void RTC_Set(const uint8_t hours, const uint8_t minutes, const uint8_t seconds);
 
@@ -38,14 +70,75 @@ void RTC_Set(const uint8_t hours, const uint8_t minutes, const uint8_t seconds);
  *  @param hours The address of a variable to store the real time clock hours.
  *  @param minutes The address of a variable to store the real time clock minutes.
  *  @param seconds The address of a variable to store the real time clock seconds.
- *  @note Assumes that the RTC module has been initialized.
+ *  @note Assumes that the RTC module has been initialized. Reads the cached time, safe to call from an ISR.
  */
 void RTC_Get(uint8_t* const hours, uint8_t* const minutes, uint8_t* const seconds);
 
+/*! @brief Sets the date of the real time clock.
+ *
+ *  @param year The desired year (1970-2105).
+ *  @param month The desired month (1-12).
+ *  @param day The desired day of the month (1-31).
+ *  @return bool - TRUE if the date was in range and has been set.
+ *  @note Assumes that the RTC module has been initialized. The time of day is kept.
+ */
+bool RTC_SetDate(const uint16_t year, const uint8_t month, const uint8_t day);
+
+/*! @brief Gets the date and time of the real time clock.
+ *
+ *  The RTC interrupt breaks the time down once a second, this copies the result without locking.
+ *  @param time The address of a variable to store the date and time.
+ *  @note Assumes that the RTC module has been initialized. Safe to call from an ISR.
+ */
+void RTC_GetTime(TRTCTime* const time);
+
+/*! @brief Gets the seconds since 1970-01-01 00:00:00, as of the last RTC interrupt.
+ *
+ *  @return uint32_t - The cached value of the time seconds register.
+ *  @note Assumes that the RTC module has been initialized. Safe to call from an ISR.
+ */
+uint32_t RTC_GetEpoch(void);
+
+/*! @brief Gets the value of the real time clock in seconds.
+ *
+ *  @return uint32_t - The number of seconds counted by the RTC.
+ *  @note Safe to call from an ISR.
+ */
+uint32_t RTC_GetSeconds(void);
+
+/*! @brief Gets the time to 1/32768 of a second.
+ *
+ *  The seconds and prescaler registers are read until they agree with each other.
+ *  @param timestamp The address of a variable to store the timestamp.
+ *  @note Assumes that the RTC module has been initialized. Safe to call from an ISR.
+ */
+void RTC_GetTimestamp(TRTCTimestamp* const timestamp);
+
+/*! @brief Sets the RTC alarm.
+ *
+ *  @param seconds The value of the time seconds register at which the alarm goes off, which must be in the future.
+ *  @param userFunction is a pointer to a user callback function, called from the alarm ISR.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @return bool - TRUE if the alarm was set.
+ *  @note Replaces an alarm that has not gone off yet. Assumes the RTC is ready.
+ */
+bool RTC_SetAlarm(const uint32_t seconds, void (*userFunction)(void*), void* userArguments);
+
+/*! @brief Cancels the RTC alarm.
+ */
+void RTC_CancelAlarm(void);
+
+/*! @brief Interrupt service routine for the RTC alarm.
+ *
+ *  The alarm has gone off, it is turned off and the user callback function is called.
+ *  @note Assumes the RTC has been initialized.
+ */
+void __attribute__ ((interrupt)) RTC_AlarmISR(void);
+
 /*! @brief Interrupt service routine for the RTC.
  *
  *  The RTC has incremented one second.
- *  The user callback function will be called.
+ *  The cached date and time are brought up to date and the one second semaphore is signalled.
  *  @note Assumes the RTC has been initialized.
  */
 void __attribute__ ((interrupt)) RTC_ISR(void);
@@ -0,0 +1,103 @@
+/*! @file
+ *
+ *  @brief Routines for a free-running 64-bit timestamp on the TWR-K70F120M.
+ *
+ *  The low word is the DWT cycle counter, which counts core clock cycles. The counter wraps every 2^32 cycles
+ *  (about 205 s at 20.97 MHz), so every read compares it with the previous read and carries into the high word.
+ *  A PIT channel reads the timestamp every second, which guarantees that no wrap is missed.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-08
+ */
+/*!
+**  @addtogroup Time_module Time module documentation
+**  @{
+*/
+/* MODULE Time */
+
+#include "brOS.h"
+
+// Period of the keep-alive reads in nanoseconds, far shorter than a wrap of the cycle counter
+#define KEEP_ALIVE_PERIOD 1000000000LU
+
+// Cycle counter enables, not in the IO map
+#define DEMCR_TRCENA_MASK       0x01000000u
+#define DWT_CTRL_CYCCNTENA_MASK 0x00000001u
+
+// Private global variables
+static uint32_t TicksPerSecond;
+static uint32_t High;     // Number of times the cycle counter has wrapped
+static uint32_t LastLow;  // The cycle counter at the previous read
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Reads the timestamp so that a wrap of the cycle counter is always seen.
+ *
+ *  @param pData is not used but is required by the PIT callback.
+ */
+static void KeepAlive(void* pData)
+{
+  (void)Time_Now();
+}
+
+// PUBLIC FUNCTIONS
+
+void Time_StartCounter(void)
+{
+  DEMCR |= DEMCR_TRCENA_MASK;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA_MASK;
+}
+
+bool Time_Init(const uint32_t coreClk)
+{
+  TicksPerSecond = coreClk;
+  High = 0;
+  LastLow = 0;
+
+  // Keep the count from Time_StartCounter, so the timestamp includes the boot before this
+  if (!(DWT_CTRL & DWT_CTRL_CYCCNTENA_MASK))
+    Time_StartCounter();
+
+  if (!PIT_Register(TIME_CHANNEL, PIT_MODE_PERIODIC, KeepAlive, NULL))
+    return false;
+
+  PIT_Set(KEEP_ALIVE_PERIOD, true, TIME_CHANNEL);
+  return true;
+}
+
+uint64_t Time_Now(void)
+{
+  uint32_t low, high;
+
+  EnterCritical();
+  low = DWT_CYCCNT;
+  if (low < LastLow)
+    High++;
+  LastLow = low;
+  high = High;
+  ExitCritical();
+
+  return ((uint64_t)high << 32) | low;
+}
+
+uint64_t Time_ToNanoseconds(const uint64_t ticks)
+{
+  // Whole seconds first, so that the product cannot overflow
+  uint64_t seconds = ticks / TicksPerSecond;
+  uint64_t remainder = ticks % TicksPerSecond;
+
+  return seconds*1000000000LLU + (remainder*1000000000LLU) / TicksPerSecond;
+}
+
+uint64_t Time_FromNanoseconds(const uint64_t nanoseconds)
+{
+  uint64_t seconds = nanoseconds / 1000000000LLU;
+  uint64_t remainder = nanoseconds % 1000000000LLU;
+
+  return seconds*TicksPerSecond + (remainder*TicksPerSecond) / 1000000000LLU;
+}
+
+/*!
+** @}
+*/
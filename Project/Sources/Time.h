@@ -0,0 +1,53 @@
+/*! @file
+ *
+ *  @brief Routines for a free-running 64-bit timestamp on the TWR-K70F120M.
+ *
+ *  This contains the functions for stamping samples, packets and events with the core cycle count.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-08
+ */
+
+#ifndef TIME_H
+#define TIME_H
+
+// new types
+#include "types.h"
+
+/*! @brief Zeroes and starts the cycle counter, so that the timestamp counts from here.
+ *
+ *  @note Needs nothing else to be initialized, main calls it first so that the timestamp times the whole boot.
+ */
+void Time_StartCounter(void);
+
+/*! @brief Starts the PIT channel that keeps the extension of the cycle counter up to date.
+ *
+ *  @param coreClk The core clock rate in Hz, which is the rate of the timestamp.
+ *  @return bool - TRUE if the timestamp was successfully initialized.
+ *  @note Assumes the PIT has been initialized. Starts the cycle counter if Time_StartCounter has not.
+ *        Nothing else may reset the cycle counter.
+ */
+bool Time_Init(const uint32_t coreClk);
+
+/*! @brief Gets the current timestamp.
+ *
+ *  @return uint64_t - The number of core clock cycles since Time_StartCounter, or Time_Init if it was not called.
+ *  @note Safe to call from an ISR.
+ */
+uint64_t Time_Now(void);
+
+/*! @brief Converts a timestamp, or the difference between two, to nanoseconds.
+ *
+ *  @param ticks The number of core clock cycles.
+ *  @return uint64_t - The same time in nanoseconds.
+ */
+uint64_t Time_ToNanoseconds(const uint64_t ticks);
+
+/*! @brief Converts a time in nanoseconds to a timestamp difference.
+ *
+ *  @param nanoseconds The time in nanoseconds.
+ *  @return uint64_t - The same time in core clock cycles.
+ */
+uint64_t Time_FromNanoseconds(const uint64_t nanoseconds);
+
+#endif
@@ -0,0 +1,319 @@
+/*! @file
+ *
+ *  @brief Routines for software timers multiplexed on one PIT channel.
+ *
+ *  Timers are kept in a hierarchical timing wheel of three levels of 64 slots. A level 0 slot holds the timers
+ *  expiring on one tick, a level 1 slot those expiring in one turn of level 0 and so on, which covers about 43 minutes.
+ *  Each slot is a circular doubly linked list, so starting and stopping a timer are constant time. Every 64 ticks
+ *  the next level 1 slot is cascaded down into level 0, and every 4096 ticks the next level 2 slot into level 1.
+ *  The PIT channel only runs while a timer is in the wheel.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+/*!
+**  @addtogroup Wheel_module Wheel module documentation
+**  @{
+*/
+/* MODULE Wheel */
+
+#include "brOS.h"
+
+#define LEVEL_BITS  6
+#define LEVEL_SLOTS (1 << LEVEL_BITS)
+#define LEVEL_MASK  (LEVEL_SLOTS - 1)
+#define NB_LEVELS   3
+
+// Longest delay the wheel holds at once, longer timers are cascaded down from the last slot until they are due
+#define WHEEL_SPAN  (1LU << (NB_LEVELS * LEVEL_BITS))
+
+// Private global variables
+static TWheelNode Slots[NB_LEVELS][LEVEL_SLOTS];
+static TWheelNode Pending;        // Thread context timers that have expired, in order of expiry
+static uint32_t   Base;           // The next tick to be processed, counts only while the wheel is running
+static uint16_t   NbInWheel;      // Timers in a slot, the PIT is stopped when there are none
+
+// Semaphores
+static OS_ECB* WheelExpired;
+
+OS_THREAD_STACK (WheelThreadStack, THREAD_STACK_SIZE);
+
+// PRIVATE FUNCTIONS
+
+/*! @brief Adds a node at the tail of a list.
+ *
+ *  @param list The head of the list.
+ *  @param node The node to add.
+ */
+static void Link(TWheelNode* const list, TWheelNode* const node)
+{
+  node->prev = list->prev;
+  node->next = list;
+  list->prev->next = node;
+  list->prev = node;
+}
+
+/*! @brief Removes a node from whichever list it is in.
+ *
+ *  @param node The node to remove.
+ */
+static void Unlink(TWheelNode* const node)
+{
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  node->next = NULL;
+  node->prev = NULL;
+}
+
+/*! @brief Moves every node of one list onto another, empty, list.
+ *
+ *  @param from The head of the list to empty.
+ *  @param to The head of the list to fill.
+ */
+static void MoveList(TWheelNode* const from, TWheelNode* const to)
+{
+  if (from->next == from)
+  {
+    to->next = to;
+    to->prev = to;
+    return;
+  }
+
+  to->next = from->next;
+  to->prev = from->prev;
+  to->next->prev = to;
+  to->prev->next = to;
+  from->next = from;
+  from->prev = from;
+}
+
+/*! @brief Puts a timer into the slot for its expiry.
+ *
+ *  @param timer The timer, which must not be in a list.
+ *  @note Must be called inside a critical section.
+ */
+static void Insert(TWheelTimer* const timer)
+{
+  int32_t delta = (int32_t)(timer->expiry - Base);
+  uint32_t due = timer->expiry;
+
+  // Overdue timers go into the next tick to be processed, very long ones into the furthest slot
+  if (delta < 0)
+    due = Base;
+  else if ((uint32_t)delta >= WHEEL_SPAN)
+    due = Base + WHEEL_SPAN - 1;
+
+  delta = (int32_t)(due - Base);
+
+  if (delta < LEVEL_SLOTS)
+    Link(&Slots[0][due & LEVEL_MASK], &timer->node);
+  else if (delta < (LEVEL_SLOTS << LEVEL_BITS))
+    Link(&Slots[1][(due >> LEVEL_BITS) & LEVEL_MASK], &timer->node);
+  else
+    Link(&Slots[2][(due >> (2*LEVEL_BITS)) & LEVEL_MASK], &timer->node);
+
+  // Start the PIT for the first timer
+  if (NbInWheel++ == 0)
+    PIT_Set(WHEEL_TICK_NS, true, WHEEL_CHANNEL);
+}
+
+/*! @brief Moves every timer in a slot of an upper level down to where it now belongs.
+ *
+ *  @param slot The slot to empty.
+ *  @note Must be called inside a critical section.
+ */
+static void Cascade(TWheelNode* const slot)
+{
+  while (slot->next != slot)
+  {
+    TWheelTimer* timer = (TWheelTimer*)slot->next;
+
+    Unlink(&timer->node);
+    NbInWheel--;
+    Insert(timer);
+  }
+}
+
+/*! @brief Advances the wheel one tick and expires the timers in the new slot.
+ *
+ *  The slot is taken off the wheel before any callback runs, so a timer started by a callback lands in a later tick.
+ *  @param pData is not used but is required by the PIT callback.
+ */
+static void Tick(void* pData)
+{
+  TWheelNode expired;
+  bool signal = false;
+
+  EnterCritical();
+
+  // Once a turn of a level is complete, the next slot of the level above comes down
+  if ((Base & LEVEL_MASK) == 0)
+  {
+    if (((Base >> LEVEL_BITS) & LEVEL_MASK) == 0)
+      Cascade(&Slots[2][(Base >> (2*LEVEL_BITS)) & LEVEL_MASK]);
+    Cascade(&Slots[1][(Base >> LEVEL_BITS) & LEVEL_MASK]);
+  }
+
+  MoveList(&Slots[0][Base & LEVEL_MASK], &expired);
+  Base++;
+
+  // Stopping a timer from a callback still unlinks it from here
+  while (expired.next != &expired)
+  {
+    TWheelTimer* timer = (TWheelTimer*)expired.next;
+
+    Unlink(&timer->node);
+    NbInWheel--;
+
+    if (timer->context == WHEEL_CONTEXT_THREAD)
+    {
+      // The wheel thread puts a periodic timer back before its callback
+      timer->pending = true;
+      Link(&Pending, &timer->node);
+      signal = true;
+      continue;
+    }
+
+    if (timer->period)
+    {
+      timer->expiry += timer->period;
+      Insert(timer);
+    }
+
+    // The callback may start or stop any timer, including this one
+    void (*userFunction)(void*) = timer->userFunction;
+    void* userArguments = timer->userArguments;
+
+    ExitCritical();
+    (*userFunction)(userArguments);
+    EnterCritical();
+  }
+
+  if (NbInWheel == 0)
+    PIT_Enable(false, WHEEL_CHANNEL);
+  ExitCritical();
+
+  if (signal)
+    OS_SemaphoreSignal(WheelExpired);
+}
+
+// THREADS
+
+/*! @brief Runs the callbacks of thread context timers as they expire.
+ *
+ *  @param pData is not used but is required by the OS to create a thread.
+ */
+static void WheelThread(void* pData)
+{
+  for (;;)
+  {
+    OS_SemaphoreWait(WheelExpired, 0);
+
+    for (;;)
+    {
+      TWheelTimer* timer;
+      void (*userFunction)(void*);
+      void* userArguments;
+
+      EnterCritical();
+      if (Pending.next == &Pending)
+      {
+        ExitCritical();
+        break;
+      }
+
+      timer = (TWheelTimer*)Pending.next;
+      Unlink(&timer->node);
+      timer->pending = false;
+
+      if (timer->period)
+      {
+        timer->expiry += timer->period;
+        Insert(timer);
+      }
+
+      userFunction = timer->userFunction;
+      userArguments = timer->userArguments;
+      ExitCritical();
+
+      (*userFunction)(userArguments);
+    }
+  }
+}
+
+// PUBLIC FUNCTIONS
+
+bool Wheel_Init(void)
+{
+  for (uint8_t level = 0; level < NB_LEVELS; level++)
+  {
+    for (uint8_t slot = 0; slot < LEVEL_SLOTS; slot++)
+    {
+      Slots[level][slot].next = &Slots[level][slot];
+      Slots[level][slot].prev = &Slots[level][slot];
+    }
+  }
+
+  Pending.next = &Pending;
+  Pending.prev = &Pending;
+  Base = 0;
+  NbInWheel = 0;
+
+  WheelExpired = OS_SemaphoreCreate(0);
+
+  if (!PIT_Register(WHEEL_CHANNEL, PIT_MODE_PERIODIC, Tick, NULL))
+    return false;
+
+  return (OS_ThreadCreate(WheelThread,
+                          NULL,
+                          &WheelThreadStack[THREAD_STACK_SIZE - 1],
+                          WHEEL_PRIORITY) == OS_NO_ERROR);
+}
+
+bool Wheel_Start(TWheelTimer* const timer, const uint32_t ticks, const uint32_t period, const TWheelContext context,
+                 void (*userFunction)(void*), void* userArguments)
+{
+  if (!timer || !userFunction || (ticks == 0))
+    return false;
+
+  EnterCritical();
+  Wheel_Stop(timer);
+
+  timer->expiry        = Base + ticks - 1;
+  timer->period        = period;
+  timer->context       = context;
+  timer->userFunction  = userFunction;
+  timer->userArguments = userArguments;
+
+  Insert(timer);
+  ExitCritical();
+
+  return true;
+}
+
+void Wheel_Stop(TWheelTimer* const timer)
+{
+  EnterCritical();
+
+  if (timer->node.next)
+  {
+    Unlink(&timer->node);
+
+    // A timer waiting for the wheel thread is not in the wheel
+    if (timer->pending)
+      timer->pending = false;
+    else if (--NbInWheel == 0)
+      PIT_Enable(false, WHEEL_CHANNEL);
+  }
+
+  ExitCritical();
+}
+
+bool Wheel_IsRunning(const TWheelTimer* const timer)
+{
+  return (timer->node.next != NULL);
+}
+
+/*!
+** @}
+*/
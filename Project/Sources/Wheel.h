@@ -0,0 +1,86 @@
+/*! @file
+ *
+ *  @brief Routines for software timers multiplexed on one PIT channel.
+ *
+ *  This contains the functions for starting and stopping any number of one-shot and periodic timers
+ *  without spending a hardware timer or an interrupt on each of them.
+ *
+ *  @author 12551382 Samin Saif and 11850637 Alex Hiller
+ *  @date 2018-07-09
+ */
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+// new types
+#include "types.h"
+
+// Period of one wheel tick in nanoseconds
+#define WHEEL_TICK_NS 10000000LU
+
+// Converts milliseconds to wheel ticks
+#define WHEEL_MS_TO_TICKS(X) (uint32_t)((X)/10)
+
+typedef enum
+{
+  WHEEL_CONTEXT_ISR,    /*!< The callback runs in the PIT ISR, it must be short and must not block */
+  WHEEL_CONTEXT_THREAD  /*!< The callback runs in the wheel thread and may block */
+} TWheelContext;
+
+typedef struct WheelNode
+{
+  struct WheelNode* next;
+  struct WheelNode* prev;
+} TWheelNode;
+
+/*!
+ * @struct TWheelTimer
+ */
+typedef struct
+{
+  TWheelNode node;                /*!< Links the timer into a wheel slot or the list of callbacks waiting for the thread */
+  uint32_t expiry;                /*!< The wheel tick at which the timer expires */
+  uint32_t period;                /*!< Ticks between expiries of a periodic timer, 0 for a one-shot timer */
+  TWheelContext context;          /*!< Where the callback runs */
+  bool pending;                   /*!< TRUE while the callback is waiting for the wheel thread */
+  void (*userFunction)(void*);    /*!< Called each time the timer expires */
+  void* userArguments;            /*!< Passed to userFunction */
+} TWheelTimer;
+
+/*! @brief Sets up the timer wheel and creates the thread that runs thread context callbacks.
+ *
+ *  @return bool - TRUE if the timer wheel was successfully initialized.
+ *  @note Assumes the PIT has been initialized.
+ */
+bool Wheel_Init(void);
+
+/*! @brief Starts a timer, or restarts it if it is already running.
+ *
+ *  @param timer The timer, which must start out zeroed and stay allocated while it is running.
+ *  @param ticks The number of ticks until the first expiry, at least 1.
+ *  @param period The number of ticks between later expiries, 0 for a one-shot timer.
+ *  @param context WHEEL_CONTEXT_ISR or WHEEL_CONTEXT_THREAD.
+ *  @param userFunction is a pointer to a user callback function.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @return bool - TRUE if the timer was started.
+ *  @note The first expiry comes between ticks - 1 and ticks periods after the call. Safe to call from an ISR or a callback.
+ */
+bool Wheel_Start(TWheelTimer* const timer, const uint32_t ticks, const uint32_t period, const TWheelContext context,
+                 void (*userFunction)(void*), void* userArguments);
+
+/*! @brief Stops a timer.
+ *
+ *  A callback that is waiting for the wheel thread is cancelled too.
+ *  @param timer The timer to stop. Stopping a timer that is not running does nothing.
+ *  @note Safe to call from an ISR or a callback.
+ */
+void Wheel_Stop(TWheelTimer* const timer);
+
+/*! @brief Checks whether a timer is running.
+ *
+ *  @param timer The timer to check.
+ *  @return bool - TRUE if the timer is in the wheel or its callback is waiting for the wheel thread.
+ */
+bool Wheel_IsRunning(const TWheelTimer* const timer);
+
+#endif
@@ -19,9 +19,14 @@
 #include "OS.h"
 #include "types.h"
 #include "Flash.h"
+#include "Counter.h"
+#include "Config.h"
+#include "EventLog.h"
 #include "FIFO.h"
 #include "UART.h"
 #include "PIT.h"
+#include "Time.h"
+#include "Wheel.h"
 #include "RTC.h"
 #include "FTM.h"
 #include "LEDs.h"
@@ -44,9 +49,14 @@ enum
   INIT_MODULES_PRIORITY,
   UART_RX_PRIORITY,
   UART_TX_PRIORITY,
+  WHEEL_PRIORITY,
   LOGIC_PRIORITY,
   RTC_PRIORITY,
   PACKET_HANDLE_PRIORITY,
+  COUNTER_PRIORITY,
+  CONFIG_PRIORITY,
+  EVENTLOG_PRIORITY,
+  FLASH_PRIORITY,
 };
 
 // Global Data Structures
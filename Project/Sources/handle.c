@@ -17,10 +17,6 @@
 
 extern TPacket Packet;
 
-// Pointers to be allocated flash memory
-static volatile uint16union_t *NvTowerNb;    // Non-volatile tower number
-static volatile uint16union_t *NvTowerMode;  // Non-volatile tower mode
-
 // PRIVATE FUNCTIONS
 
 static void SendAckPacket(void)
@@ -50,10 +46,13 @@ static bool HandleGetStartupValues(void)
   // Normal action
   else
   {
+    uint16union_t towerNb   = (uint16union_t)((uint16_t)Config_Get(CONFIG_TOWER_NB));
+    uint16union_t towerMode = (uint16union_t)((uint16_t)Config_Get(CONFIG_TOWER_MODE));
+
     Packet_Put(TOWER_STARTUP, 0, 0, 0);
     Packet_Put(TOWER_VERSION, 'v', 1, 0);
-    Packet_Put(TOWER_NUMBER, 1, NvTowerNb->s.Lo, NvTowerNb->s.Hi);
-    Packet_Put(TOWER_MODE, 1, NvTowerMode->s.Lo, NvTowerMode->s.Hi);
+    Packet_Put(TOWER_NUMBER, 1, towerNb.s.Lo, towerNb.s.Hi);
+    Packet_Put(TOWER_MODE, 1, towerMode.s.Lo, towerMode.s.Hi);
     return true;
   }
 }
@@ -90,7 +89,8 @@ static bool HandleTowerNumber(void)
     // Normal action
     else
     {
-      Packet_Put(TOWER_NUMBER, 1, NvTowerNb->s.Lo, NvTowerNb->s.Hi);
+      uint16union_t towerNb = (uint16union_t)((uint16_t)Config_Get(CONFIG_TOWER_NB));
+      Packet_Put(TOWER_NUMBER, 1, towerNb.s.Lo, towerNb.s.Hi);
       return true;
     }
   }
@@ -102,9 +102,9 @@ static bool HandleTowerNumber(void)
     if ((Packet_Parameter2 > 0xFF) || (Packet_Parameter3 > 0xFF))
       return false;
 
-    // Normal action
+    // Normal action, the tower number must be in Flash before it is acknowledged
     else
-      return Flash_Write16(&(NvTowerNb->l), Packet_Parameter23);
+      return Config_Set(CONFIG_TOWER_NB, Packet_Parameter23);
   }
 }
 
@@ -125,7 +125,8 @@ static bool HandleTowerMode(void)
     // Normal action
     else
     {
-      Packet_Put(TOWER_MODE, 1, NvTowerNb->s.Lo, NvTowerNb->s.Hi);
+      uint16union_t towerMode = (uint16union_t)((uint16_t)Config_Get(CONFIG_TOWER_MODE));
+      Packet_Put(TOWER_MODE, 1, towerMode.s.Lo, towerMode.s.Hi);
       return true;
     }
   }
@@ -137,9 +138,9 @@ static bool HandleTowerMode(void)
     if ((Packet_Parameter2 > 0xFF) || (Packet_Parameter3 > 0xFF))
       return false;
 
-    // Normal action
+    // Normal action, the tower mode must be in Flash before it is acknowledged
     else
-      return Flash_Write16(&(NvTowerMode->l), Packet_Parameter23);
+      return Config_Set(CONFIG_TOWER_MODE, Packet_Parameter23);
   }
 }
 
@@ -159,8 +160,8 @@ static bool HandleFlashProgramByte(void)
   // If parameter1 is within the range of 0x00-0x07
   else
   {
-    uint32_t offsetAddress = (uint32_t)FLASH_DATA_START + (uint32_t)Packet_Parameter1;
-    return Flash_Write8((uint8_t*)offsetAddress, Packet_Parameter3);
+    uint32_t offsetAddress = (uint32_t)FLASH_SHADOW_START + (uint32_t)Packet_Parameter1;
+    return Flash_Write8((uint8_t*)offsetAddress, Packet_Parameter3) && Flash_Sync();
   }
 }
 
@@ -174,8 +175,8 @@ static bool HandleFlashReadByte(void)
   // Normal action
   else
   {
-    uint32_t offsetAddress = (uint32_t)FLASH_DATA_START + (uint32_t)Packet_Parameter1;
-    uint8_t data = _FB(offsetAddress); // _FB macro function casts it as a 8-bit pointer.
+    uint32_t offsetAddress = (uint32_t)FLASH_SHADOW_START + (uint32_t)Packet_Parameter1;
+    uint8_t data = _FB(offsetAddress); // _FB macro function casts it as a 8-bit pointer, the shadow holds the latest value written, which may not have been committed to Flash yet.
     Packet_Put(FLASH_READ_BYTE, Packet_Parameter1, 0, data);
     return true;
   }
@@ -201,12 +202,14 @@ static bool HandleTimingMode(void)
   if (AlarmStopWatch.TimingType == DEF_TIMING)
   {
     AlarmStopWatch.TimingType = INV_TIMING;
-    return true;
+    EventLog_Post(EVENT_TIMING_MODE, INV_TIMING);
+    return Config_Set(CONFIG_TIMING_TYPE, INV_TIMING);
   }
   else if (AlarmStopWatch.TimingType == INV_TIMING)
   {
     AlarmStopWatch.TimingType = DEF_TIMING;
-    return true;
+    EventLog_Post(EVENT_TIMING_MODE, DEF_TIMING);
+    return Config_Set(CONFIG_TIMING_TYPE, DEF_TIMING);
   }
   else
   {
@@ -218,12 +221,13 @@ static bool HandleNbRaises(void)
 {
   if (Packet_Parameter1 == GET_NV)
   {
-    Packet_Put(Packet_Command, PhaseA.NvNbRaises->s.Lo, PhaseA.NvNbRaises->s.Hi, 0);
+    uint16union_t nbRaises = (uint16union_t)((uint16_t)Counter_Get(COUNTER_RAISES));
+    Packet_Put(Packet_Command, nbRaises.s.Lo, nbRaises.s.Hi, 0);
   }
 
   if (Packet_Parameter1 == RESET_NV)
   {
-    // TODO
+    Counter_Reset(COUNTER_RAISES);
   }
 
   return true;
@@ -233,12 +237,13 @@ static bool HandleNbLowers(void)
 {
     if (Packet_Parameter1 == GET_NV)
     {
-      Packet_Put(Packet_Command, PhaseA.NvNbLowers->s.Lo, PhaseA.NvNbLowers->s.Hi, 0);
+      uint16union_t nbLowers = (uint16union_t)((uint16_t)Counter_Get(COUNTER_LOWERS));
+      Packet_Put(Packet_Command, nbLowers.s.Lo, nbLowers.s.Hi, 0);
     }
 
     if (Packet_Parameter1 == RESET_NV)
     {
-      // TODO
+      Counter_Reset(COUNTER_LOWERS);
     }
 
     return true;
@@ -276,6 +281,34 @@ static bool HandleSpectrum(void)
 
 }
 
+static bool HandleEventLog(void)
+{
+  // If the received packet has any invalid parameters
+  if ((Packet_Parameter1 != 0) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+    return false;
+
+  // Normal action
+  else
+    return EventLog_Dump();
+}
+
+static bool HandleFlashBenchmark(void)
+{
+  uint32_t phraseRate, sectionRate;
+
+  // If the received packet has any invalid parameters
+  if ((Packet_Parameter1 != 0) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+    return false;
+
+  // Normal action, reply with the Program Phrase rate then the Program Section rate, each in bytes per second (24-bit, LSB first)
+  else if (!Flash_Benchmark(&phraseRate, &sectionRate))
+    return false;
+
+  Packet_Put(FLASH_BENCHMARK, (uint8_t)phraseRate, (uint8_t)(phraseRate >> 8), (uint8_t)(phraseRate >> 16));
+  Packet_Put(FLASH_BENCHMARK, (uint8_t)sectionRate, (uint8_t)(sectionRate >> 8), (uint8_t)(sectionRate >> 16));
+  return true;
+}
+
 // PUBLIC FUNCTIONS
 
 void Handle_Packet(void)
@@ -344,6 +377,14 @@ void Handle_Packet(void)
       success = HandleSpectrum();
       break;
 
+    case (EVENT_LOG):
+      success = HandleEventLog();
+      break;
+
+    case (FLASH_BENCHMARK):
+      success = HandleFlashBenchmark();
+      break;
+
     default:
       success = HandleInvalidCommand();
   }
@@ -364,36 +405,18 @@ void Handle_Packet(void)
 }
 
 
-bool Initial_TowerNb(void)
-{
-  if (!Flash_AllocateVar((void*)&NvTowerNb, sizeof(*NvTowerNb)))
-    return false;
-
-  else if (NvTowerNb->l == 0xFFFF)
-    return Flash_Write16(&(NvTowerNb->l), 1382);
-
-  else
-    return Flash_Write16(&(NvTowerNb->l), NvTowerNb->l);
-}
-
-bool Initial_TowerMode(void)
-{
-  if (!Flash_AllocateVar((void*)&NvTowerMode, sizeof(*NvTowerMode)))
-    return false;
-
-  else if (NvTowerMode->l == 0xFFFF)
-    return Flash_Write16(&(NvTowerMode->l), 1);
-
-  else
-    return Flash_Write16(&(NvTowerMode->l), NvTowerMode->l);
-}
-
 bool Tower_Startup(void)
 {
+  uint16union_t towerNb   = (uint16union_t)((uint16_t)Config_Get(CONFIG_TOWER_NB));
+  uint16union_t towerMode = (uint16union_t)((uint16_t)Config_Get(CONFIG_TOWER_MODE));
+  uint64_t bootMs = Time_ToNanoseconds(Time_Now()) / 1000000;  // Since main started, PE and OS initialization included
+  uint16union_t bootTime = (uint16union_t)((uint16_t)((bootMs > 0xFFFF) ? 0xFFFF : bootMs));
+
   Packet_Put(TOWER_STARTUP, 0, 0, 0);
   Packet_Put(TOWER_VERSION, 'v', 1, 0);
-  Packet_Put(TOWER_NUMBER, 1, NvTowerNb->s.Lo, NvTowerNb->s.Hi);
-  Packet_Put(TOWER_MODE, 1, NvTowerMode->s.Lo, NvTowerMode->s.Hi);
+  Packet_Put(TOWER_NUMBER, 1, towerNb.s.Lo, towerNb.s.Hi);
+  Packet_Put(TOWER_MODE, 1, towerMode.s.Lo, towerMode.s.Hi);
+  Packet_Put(BOOT_TIME, 0, bootTime.s.Lo, bootTime.s.Hi);
   return true;
 }
 
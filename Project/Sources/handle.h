@@ -26,11 +26,16 @@
 #define FREQ                0x17
 #define VOLTAGE             0x18
 #define SPECTRUM            0x19
+#define EVENT_LOG           0x1A
+#define FLASH_BENCHMARK     0x1C
 
 // Tower to PC commands
 #define TOWER_STARTUP       0x04
 #define TOWER_VERSION       0x09
 #define PROTOCOL_MODE	      0x0A
+#define EVENT_TIME          0x1B
+#define BOOT_TIME           0x1D
+#define EVENT_FRACTION      0x1E
 
 // Accelerometer macros
 #define GET_PROTOCOL	    0x01
@@ -50,21 +55,10 @@ enum
  */
 void Handle_Packet(void);
 
-/*! @brief Sets the tower number to last 4 digits of student number and stores in flash if tower number has not yet been written.
+/*! @brief Sends the initial 4 packets when tower starts up, followed by the boot time.
  *
- *  @return bool - TRUE if the tower number was successfully stored in flash.
- */
-bool Initial_TowerNb(void);
-
-/*! @brief Sets the tower mode to 1 and stores in flash if tower mode has not yet been set.
- *
- *  @return bool - TRUE if the tower mode was successfully stored in flash.
- */
-bool Initial_TowerMode(void);
-
-/*! @brief Sends the initial 4 packets when tower starts up.
- *
- *  @return bool - TRUE if the 4 packets are all successfully sent.
+ *  The boot time packet holds the milliseconds from the start of the timestamp to the first packet.
+ *  @return bool - TRUE if the 5 packets are all successfully sent.
  */
 bool Tower_Startup(void);
 
@@ -80,6 +74,18 @@ static bool HandleVoltage(void);
 
 static bool HandleSpectrum(void);
 
+/*! @brief Sends every record in the event log to the PC.
+ *
+ *  @return bool - TRUE if the parameters are all 0 and the log was dumped.
+ */
+static bool HandleEventLog(void);
+
+/*! @brief Measures the Program Phrase and Program Section rates and sends them to the PC.
+ *
+ *  @return bool - TRUE if the parameters are all 0 and the benchmark ran.
+ */
+static bool HandleFlashBenchmark(void);
+
 
 
 #endif /* HANDLE_H_ */
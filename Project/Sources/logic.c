@@ -109,27 +109,58 @@ void Logic_FrequencyTracking(void)
   uint8_t n = PhaseA.ZeroCrossingIndex[1]-PhaseA.ZeroCrossingIndex[0]; // a2's index - a1's index
   float WavePeriod = (n*Ts-t1+t2)*2;
   // If the period of the wave indicates it's within 45hz-55Hz, then adjust the sample time and saved freq.
-  if ( ((uint32_t)(WavePeriod/(16.0)*1e9) > 1136400 ) && ((uint32_t)(WavePeriod/(16.0)*1e9) < 1388900 ))
+  uint32_t sampleNs = (uint32_t)(WavePeriod/(16.0)*1e9);
+  if ((sampleNs > 1136400) && (sampleNs < 1388900))
   {
-    // Save sampling time in ns into global struct for accessibility
-    AlarmStopWatch.WaveformSampleNs = (uint32_t)(WavePeriod/(16.0)*1e9);
     // Save frequency for communication with PC
     AlarmStopWatch.WaveformFrequency = (float)1.0/(float)WavePeriod;
-    // Set new Waveform sampling rate
+
+    // Set new Waveform sampling rate, from the next reload so that no partial period is lost
+    if (sampleNs != AlarmStopWatch.WaveformSampleNs)
+    {
+      // Save sampling time in ns into global struct for accessibility
+      AlarmStopWatch.WaveformSampleNs = sampleNs;
+      PIT_Set(sampleNs, false, SAMPLING_CHANNEL);
+    }
+  }
+}
+
+bool Logic_OutputInit(void)
+{
+  // Route FTM0 channels 1 to 3 to their pins - PTA4, PTA5 and PTA6 are ALT3 (FTM0_CH1 to FTM0_CH3)
+  SIM_SCGC5 |= SIM_SCGC5_PORTA_MASK;
+  PORTA_PCR4 = PORT_PCR_MUX(3);
+  PORTA_PCR5 = PORT_PCR_MUX(3);
+  PORTA_PCR6 = PORT_PCR_MUX(3);
+
+  for (uint8_t channel = RAISE_CHANNEL; channel <= ALARM_CHANNEL; channel++)
+  {
+    FTMChLoad[channel].channelNb            = channel;
+    FTMChLoad[channel].delayCount           = 0;
+    FTMChLoad[channel].timerFunction        = TIMER_FUNCTION_OUTPUT_COMPARE;
+    FTMChLoad[channel].ioType.outputAction  = TIMER_OUTPUT_LOW;
+    FTMChLoad[channel].userFunction         = NULL;
+    FTMChLoad[channel].userArguments        = NULL;
+
+    // Claim the channel so that FTM_Schedule leaves it alone, then start it low
+    if (!FTM_Set(&FTMChLoad[channel]) || !FTM_SetOutput(channel, OFF))
+      return false;
   }
-  PIT_Set(AlarmStopWatch.WaveformSampleNs, true, SAMPLING_CHANNEL);
+
+  return true;
 }
 
 void Logic_OutputRaise(bool status)
 {
   if (status == ON)
     {
-      Analog_Put(RAISE_CHANNEL, VOLT_SIGNAL);
-      Flash_NbRaises();
+      FTM_Pulse(RAISE_CHANNEL, TAP_PULSE_COUNTS);
+      Counter_Increment(COUNTER_RAISES);
+      EventLog_Post(EVENT_RAISE, 0);
     }
   if (status == OFF)
     {
-      Analog_Put(RAISE_CHANNEL, VOLT_IDLE);
+      FTM_SetOutput(RAISE_CHANNEL, OFF);
     }
 }
 
@@ -137,78 +168,197 @@ void Logic_OutputLower(bool status)
 {
   if (status == ON)
     {
-      Analog_Put(LOWER_CHANNEL, VOLT_SIGNAL);
-      Flash_NbLowers();
+      FTM_Pulse(LOWER_CHANNEL, TAP_PULSE_COUNTS);
+      Counter_Increment(COUNTER_LOWERS);
+      EventLog_Post(EVENT_LOWER, 0);
     }
   if (status == OFF)
     {
-      Analog_Put(LOWER_CHANNEL, VOLT_IDLE);
+      FTM_SetOutput(LOWER_CHANNEL, OFF);
     }
 }
 
 void Logic_OutputAlarm(bool status)
 {
+  static bool alarmOn = OFF;  // Only changes of the alarm are recorded, it is driven on every sample window
+
   if (status == ON)
     {
-      Analog_Put(ALARM_CHANNEL, VOLT_SIGNAL);
+      if (alarmOn == OFF)
+      {
+        FTM_SetOutput(ALARM_CHANNEL, ON);
+        EventLog_Post(EVENT_ALARM_SET, 0);
+      }
     }
   if (status == OFF)
     {
-      Analog_Put(ALARM_CHANNEL, VOLT_IDLE);
+      if (alarmOn == ON)
+      {
+        FTM_SetOutput(ALARM_CHANNEL, OFF);
+        EventLog_Post(EVENT_ALARM_CLEAR, 0);
+      }
     }
+  alarmOn = status;
+  }
+
+/*! @brief Converts a time in seconds to a timestamp difference.
+ *
+ *  @param seconds The time in seconds.
+ *  @return uint64_t - The same time in core clock cycles.
+ */
+static uint64_t SecondsToTicks(const float seconds)
+{
+  return Time_FromNanoseconds((uint64_t)(seconds * 1e9));
+}
+
+/*! @brief Programs the deadline PIT channel to time out at the alarm deadline.
+ *
+ *  @note Must be called inside a critical section.
+ */
+static void ProgramDeadline(void)
+{
+  uint64_t now = Time_Now();
+  uint64_t remaining = 0;
+
+  if (AlarmStopWatch.Deadline > now)
+    remaining = Time_ToNanoseconds(AlarmStopWatch.Deadline - now);
+
+  // The PIT only counts a few seconds at a time, so a long deadline takes several steps
+  if (remaining > DEADLINE_MAX_STEP_NS)
+    remaining = DEADLINE_MAX_STEP_NS;
+  else if (remaining < DEADLINE_SLACK_NS)
+    remaining = DEADLINE_SLACK_NS;
+
+  PIT_Set((uint32_t)remaining, true, DEADLINE_CHANNEL);
+}
+
+/*! @brief Starts timing an alarm from the beginning.
+ *
+ *  @param tripTime The number of seconds until the taps operate.
+ *  @note Must be called inside a critical section.
+ */
+static void ArmDeadline(const float tripTime)
+{
+  uint64_t now = Time_Now();
+
+  AlarmStopWatch.TripTime   = tripTime;
+  AlarmStopWatch.Progress   = 0;
+  AlarmStopWatch.LastUpdate = now;
+  AlarmStopWatch.Deadline   = now + SecondsToTicks(tripTime);
+  ProgramDeadline();
+}
+
+/*! @brief Operates the taps once the alarm deadline is reached.
+ *
+ *  @param pData is not used but is required by the PIT callback.
+ *  @note Called from the deadline PIT channel's ISR.
+ */
+static void DeadlineCallback(void* pData)
+{
+  if (AlarmStopWatch.SetLevel == NOT_SET)
+    return;
+
+  // Not there yet, either the deadline was too far away for one step or the PIT ran short
+  uint64_t now = Time_Now();
+  if ((AlarmStopWatch.Deadline > now) && (Time_ToNanoseconds(AlarmStopWatch.Deadline - now) > DEADLINE_SLACK_NS))
+  {
+    ProgramDeadline();
+    return;
   }
 
+  switch (AlarmStopWatch.SetLevel)
+  {
+    case (SET_HIGH):
+      Logic_OutputLower(ON);
+      break;
+    case (SET_LOW):
+      Logic_OutputRaise(ON);
+      break;
+  }
+
+  // Operate the taps again after another trip time if the voltage stays out of limits
+  ArmDeadline(AlarmStopWatch.TripTime);
+}
+
 bool Logic_AlarmStopWatchInit(TAlarmStopWatch * const aAlarmStopWatch)
 {
   aAlarmStopWatch->SetLevel           = 0;
-  aAlarmStopWatch->StopWatch          = 0;
-  aAlarmStopWatch->StopWatchStop      = 0;
-  aAlarmStopWatch->TimingType         = DEF_TIMING; // Sets up definite timing to begin with.
+  aAlarmStopWatch->Deadline           = 0;
+  aAlarmStopWatch->LastUpdate         = 0;
+  aAlarmStopWatch->TripTime           = 0;
+  aAlarmStopWatch->Progress           = 0;
+  aAlarmStopWatch->TimingType         = (uint8_t)Config_Get(CONFIG_TIMING_TYPE); // Timing type chosen before the last reset
   aAlarmStopWatch->WaveformSampleNs   = INITIAL_SAMPLE_T;
   aAlarmStopWatch->WaveformFrequency  = 50;
-  return true;
+
+  // The deadline channel only runs while an alarm is set
+  return PIT_Register(DEADLINE_CHANNEL, PIT_MODE_ONE_SHOT, DeadlineCallback, NULL);
 }
 
 void Logic_DefiniteAlarm(uint8_t setting)
 {
-  AlarmStopWatch.SetLevel       = setting;
-  AlarmStopWatch.StopWatch      = 0;
-  AlarmStopWatch.StopWatchStop  = MILLISEC_TO_INT(5000);
+  EnterCritical();
+  AlarmStopWatch.SetLevel = setting;
+  ArmDeadline(DEFINITE_TRIP_TIME);
+  ExitCritical();
 }
 
 void Logic_InverseAlarm(uint8_t setting)
 {
-  AlarmStopWatch.SetLevel = setting;
   // FIXME: Just using Phase A for this calculation for now. This correct?
+  float voltDev = (PhaseA.VoltDev > MIN_VOLT_DEV) ? PhaseA.VoltDev : MIN_VOLT_DEV;
+  float tripTime = INVERSE_TRIP_CONSTANT / voltDev;
+
+  EnterCritical();
 
-  // If no alarm going
-  if (AlarmStopWatch.SetLevel != NOT_SET)
+  // A new alarm starts at the beginning of the curve
+  if (AlarmStopWatch.SetLevel != setting)
   {
-      AlarmStopWatch.StopWatchStop = MILLISEC_TO_INT(1000*0.5*5.0/(PhaseA.VoltDev));
-//      AlarmStopWatch.StopWatch = RESET;
+    AlarmStopWatch.SetLevel = setting;
+    ArmDeadline(tripTime);
   }
-  // Else must be some time on stopwatch
+  // Otherwise the time so far counts at the old deviation, and the rest of the curve runs at the new one
   else
   {
-    AlarmStopWatch.StopWatchStop = MILLISEC_TO_INT(1000*(0.5*5.0/(PhaseA.VoltDev))*(1.0 - (float)((AlarmStopWatch.StopWatch)/(AlarmStopWatch.StopWatchStop))));
-    // Reset the stopwatch
-//    AlarmStopWatch.StopWatch = RESET;
+    uint64_t now = Time_Now();
+
+    AlarmStopWatch.Progress += (float)Time_ToNanoseconds(now - AlarmStopWatch.LastUpdate) * 1e-9 / AlarmStopWatch.TripTime;
+    if (AlarmStopWatch.Progress > 1)
+      AlarmStopWatch.Progress = 1;
+
+    AlarmStopWatch.TripTime   = tripTime;
+    AlarmStopWatch.LastUpdate = now;
+    AlarmStopWatch.Deadline   = now + SecondsToTicks((1 - AlarmStopWatch.Progress) * tripTime);
+    ProgramDeadline();
   }
+
+  ExitCritical();
+}
+
+void Logic_CancelAlarm(void)
+{
+  EnterCritical();
+  AlarmStopWatch.SetLevel = NOT_SET;
+  PIT_Enable(false, DEADLINE_CHANNEL);
+  ExitCritical();
 }
 
 uint8_t Logic_CheckRMS(void)
 {
+  float upperLimit = Config_GetFloat(CONFIG_RMS_UPPER_LIMIT);
+  float lowerLimit = Config_GetFloat(CONFIG_RMS_LOWER_LIMIT);
+
   // Check if above
-  if (PhaseA.RmsVal > RMS_UPPER_LIMIT  ||
-      PhaseB.RmsVal > RMS_UPPER_LIMIT  ||
-      PhaseC.RmsVal > RMS_UPPER_LIMIT)
+  if (PhaseA.RmsVal > upperLimit  ||
+      PhaseB.RmsVal > upperLimit  ||
+      PhaseC.RmsVal > upperLimit)
   {
     return RMS_HIGH;
   }
   // Check if below
-  else if ( PhaseA.RmsVal < RMS_LOWER_LIMIT  ||
-            PhaseB.RmsVal < RMS_LOWER_LIMIT  ||
-            PhaseC.RmsVal < RMS_LOWER_LIMIT )
+  else if ( PhaseA.RmsVal < lowerLimit  ||
+            PhaseB.RmsVal < lowerLimit  ||
+            PhaseC.RmsVal < lowerLimit )
   {
     return RMS_LOW;
   }
@@ -221,7 +371,7 @@ uint8_t Logic_CheckRMS(void)
 
 void Logic_VoltageDev(float rms, float* vDev)
 {
-  if (rms >= (float)RMS_UPPER_LIMIT)
+  if (rms >= Config_GetFloat(CONFIG_RMS_UPPER_LIMIT))
   {
     *vDev = (float)RMS_NOMINAL - rms;
     if ( (*vDev) < 0)
@@ -230,7 +380,7 @@ void Logic_VoltageDev(float rms, float* vDev)
     }
   }
 
-  if (rms <= (float)RMS_LOWER_LIMIT)
+  if (rms <= Config_GetFloat(CONFIG_RMS_LOWER_LIMIT))
   {
     *vDev = (float)RMS_NOMINAL - rms;
     if ( (*vDev) < 0)
@@ -21,7 +21,11 @@
 #define NB_SAMPLES          16
 #define ON                  true
 #define OFF                 false
-#define MILLISEC_TO_INT(X)  (uint32_t)((X)/10)
+#define DEFINITE_TRIP_TIME    5.0   // Seconds out of limits before definite timing operates the taps
+#define INVERSE_TRIP_CONSTANT 2.5   // Volt-seconds, inverse timing operates the taps after this over the deviation
+#define MIN_VOLT_DEV          0.01  // Deviation used for the inverse-time curve when the deviation is smaller
+#define DEADLINE_MAX_STEP_NS  4000000000LU  // Longest period PIT_Set can program
+#define DEADLINE_SLACK_NS     50000         // A deadline this close is taken as reached
 #define HIGH_RMS            (float)3.0
 #define LOW_RMS             (float)2.0
 #define RESET               0
@@ -30,16 +34,15 @@
 #define DAC_BITS_PER_VOLT         3276.7
 #define DAC_VOLTS(X)              (int16_t)( ((float)DAC_BITS_PER_VOLT) * ((float)X) )
 #define ADC_VOLTS(X)              (float)X/(float)DAC_BITS_PER_VOLT
-#define VOLT_SIGNAL               DAC_VOLTS(5)
-#define VOLT_IDLE                 DAC_VOLTS(0)
 #define RMS_UPPER_LIMIT           3
 #define RMS_LOWER_LIMIT           2
 #define RMS_NOMINAL               2.5
 #define INITIAL_SAMPLE_T          1250000 // Nanoseconds per sample period to acquire 16 samples for 50Hz signal
 #define NB_PHASES                 3 // On input side
-#define RAISE_CHANNEL             1 // On output side
-#define LOWER_CHANNEL             2 // On output side
-#define ALARM_CHANNEL             3 // On output side
+#define RAISE_CHANNEL             1 // On output side, FTM0 channel on PTA4
+#define LOWER_CHANNEL             2 // On output side, FTM0 channel on PTA5
+#define ALARM_CHANNEL             3 // On output side, FTM0 channel on PTA6
+#define TAP_PULSE_COUNTS          (CPU_MCGFF_CLK_HZ_CONFIG_0 / 2) // Half a second of the FTM clock per tap command
 #define DEBUGGING_CHANNEL         0
 #define CHANNEL_A                 1 // On input side
 #define CHANNEL_B                 2 // On input side
@@ -76,14 +79,14 @@ typedef struct
   float     RmsVal;
   float     VoltDev;
   uint8_t   ZeroCrossingIndex[2];
-  volatile uint16union_t *NvNbLowers;  // Non-volatile number of lower taps
-  volatile uint16union_t *NvNbRaises;  // Non-volatile number of raise taps
 } TData;
 
 typedef struct
 {
-  uint32_t StopWatch;
-  uint32_t StopWatchStop;
+  uint64_t Deadline;        /*!< Timestamp at which the taps operate */
+  uint64_t LastUpdate;      /*!< Timestamp at which Progress was last brought up to date */
+  float TripTime;           /*!< Seconds from the start of the curve to operating the taps, at the latest deviation */
+  float Progress;           /*!< Fraction of the inverse-time curve already run */
   uint8_t SetLevel;
   uint8_t TimingType;
   uint32_t WaveformSampleNs;
@@ -131,14 +134,23 @@ void Logic_FrequencyTracking(void);
  */
 bool Logic_ZeroCrossings(const float sample[], uint8_t size, uint8_t crossing[]);
 
+/*! @brief Routes the raise, lower and alarm outputs to their FTM0 channels and drives them low.
+ *
+ *  @return bool - TRUE if the outputs were set up.
+ *  @note Assumes the FTM has been initialized.
+ */
+bool Logic_OutputInit(void);
+
 /*! @brief Changes the status of the 'Raise' tap based on function input.
  *
+ *  ON sends a TAP_PULSE_COUNTS pulse timed by the FTM, OFF drives the output low straight away.
  *  @param status indicates to either turn on or off the 'Raise' tap.
  */
 void Logic_OutputRaise(bool status);
 
 /*! @brief Changes the status of the 'Lower' tap based on function input.
  *
+ *  ON sends a TAP_PULSE_COUNTS pulse timed by the FTM, OFF drives the output low straight away.
  *  @param status indicates to either turn on or off the 'Lower' tap.
  */
 void Logic_OutputLower(bool status);
@@ -155,6 +167,10 @@ void Logic_OutputAlarm(bool status);
  */
 bool Logic_AlarmStopWatchInit(TAlarmStopWatch * const aAlarmStopWatch);
 
+/*! @brief Clears the alarm and stops its deadline.
+ */
+void Logic_CancelAlarm(void);
+
 /*! @brief Checks the RMSvals in the global data struct if they exceed limits
  *
  *  @return RMS_FINE = 0, RMS_LOW = 1, RMS_HIGH = 2
@@ -164,15 +180,17 @@ uint8_t Logic_CheckRMS(void);
 
 /*! @brief Sets an alarm in Definite Timing mode.
  *
+ *  The taps operate DEFINITE_TRIP_TIME seconds from now, exactly, unless the alarm is cancelled first.
  *  @param setting specifies whether it will turn the output on or off.
- *  @note Outputs put to DAC stay that way until re-initialised.
+ *  @note Each time the deadline is reached the tap output sends another pulse.
  */
 void Logic_DefiniteAlarm(uint8_t setting);
 
 /*! @brief Sets an alarm in Inverse Timing mode.
  *
+ *  Called again with the same setting, the deadline moves to follow the inverse-time curve of the latest deviation.
  *  @param setting specifies whether it will turn the output on or off.
- *  @note Outputs put to DAC stay that way until re-initialised.
+ *  @note Each time the deadline is reached the tap output sends another pulse.
 */
 void Logic_InverseAlarm(uint8_t setting);
 
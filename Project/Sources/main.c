@@ -33,15 +33,19 @@
 
 static bool Tower_Init(void)
 {
-  return (FTM_Init()                                  &&  // Initialise FTM module
-          RTC_Init()                                  &&  // Initialise RTC module
-          PIT_Init(CPU_BUS_CLK_HZ)                    &&  // Initialise PIT module
+  return (PIT_Init(CPU_BUS_CLK_HZ)                    &&  // Initialise PIT module
+          Time_Init(CPU_CORE_CLK_HZ)                  &&  // Extend the cycle counter started by main to a 64-bit timestamp
+          Wheel_Init()                                &&  // Initialise the software timers
+          FTM_Init()                                  &&  // Initialise FTM module
+          RTC_Init()                                  &&  // Start the RTC oscillator, the RTC counts once it has settled
           Packet_Init(BAUD_RATE, CPU_BUS_CLK_HZ)      &&  // Initialise packet module
           LEDs_Init()                                 &&  // Initialise LED module
+          Logic_OutputInit()                          &&  // Route the raise, lower and alarm outputs to the FTM
           Flash_Init()                                &&  // Initialise flash module
+          Counter_Init()                              &&  // Recover tap counters from the flash log
+          Config_Init()                               &&  // Load tower number, mode and limits from flash
+          EventLog_Init()                             &&  // Find the head of the event log in flash
           Analog_Init((uint32_t)CPU_BUS_CLK_HZ)       &&  // Initialise analog module
-//          Initial_TowerNb()                           &&  // Write tower number as last 4 digits of student number to flash
-//          Initial_TowerMode()                         &&  // Write tower mode as 1 to flash
           (Logic_SampleInit(&PhaseA))                 &&
           (Logic_SampleInit(&PhaseB))                 &&
           (Logic_SampleInit(&PhaseC))                 &&
@@ -58,12 +62,44 @@ static void RTCThread(void* pData)
   {
     OS_SemaphoreWait(OneSecond, 0);
 
-    RTC_Get(&hours, &minutes, &seconds);            // Get time from RTC_TSR in hours, minutes, and seconds
+    RTC_Get(&hours, &minutes, &seconds);            // Get the time cached by the RTC interrupt
     Packet_Put(SET_TIME, hours, minutes, seconds);  // Send time to PC
     LEDs_Toggle(LED_YELLOW);                        // Toggle yellow LED
   }
 }
 
+/*! @brief Takes one sample of each phase, called by the sampling PIT channel.
+ *
+ *  @param pData is not used but is required by the PIT callback.
+ */
+static void SampleCallback(void* pData)
+{
+  // TODO: Remove the three separate counters, they'll always be sampled at the same time, hence the counters will always be equal.
+  Analog_Get(CHANNEL_A, &NewestPhaseA);
+  PhaseA.Counter++;
+  Analog_Get(CHANNEL_B, &NewestPhaseB);
+  PhaseB.Counter++;
+  Analog_Get(CHANNEL_C, &NewestPhaseC);
+  PhaseC.Counter++;
+
+  if (PhaseA.Counter >= 16 || PhaseB.Counter >= 16 || PhaseC.Counter >= 16  )
+  {
+    if (PhaseA.Counter >= NB_SAMPLES)
+    {
+      PhaseA.Counter -= 16;
+    }
+    if (PhaseB.Counter >= NB_SAMPLES)
+    {
+      PhaseB.Counter -= 16;
+    }
+    if (PhaseC.Counter >= NB_SAMPLES)
+    {
+      PhaseC.Counter -= 16;
+    }
+    OS_SemaphoreSignal(SampleComplete);
+  }
+}
+
 /*! @brief Initializes the modules to support the LEDs and low power timer.
  *
  *  @param pData is not used but is required by the OS to create a thread.
@@ -81,13 +117,10 @@ static void InitModulesThread(void* pData)
     LEDs_On(LED_ORANGE);
 
   // Set up timer for sampling
+  PIT_Register(SAMPLING_CHANNEL, PIT_MODE_PERIODIC, SampleCallback, NULL);
   PIT_Set(INITIAL_SAMPLE_T, false, SAMPLING_CHANNEL);
   PIT_Enable(ON, SAMPLING_CHANNEL);
 
-  // Set a PIT for a stopwatch
-  PIT_Set(1e7, false, STOPWATCH_CHANNEL);
-  PIT_Enable(ON, STOPWATCH_CHANNEL);
-
   OS_ThreadDelete(OS_PRIORITY_SELF);  // We only do this once - therefore we should now delete this thread
 }
 
@@ -114,6 +147,8 @@ static void PacketHandleThread(void* pData)
   */
 static void LogicThread(void* pData)
 {
+  uint8_t lastRmsState = RMS_FINE;
+
   for (;;)
   {
     OS_SemaphoreWait(SampleComplete, 0);
@@ -154,15 +189,36 @@ static void LogicThread(void* pData)
     // FFT
 //    Logic_Fft((float complex*)PhaseAVolt, NB_SAMPLES);
 
+    uint8_t rmsState = Logic_CheckRMS();
+
+    // Record excursions as they start and end
+    if (rmsState != lastRmsState)
+    {
+      uint8_t rmsTenths = (PhaseA.RmsVal < 25.5) ? (uint8_t)(10*PhaseA.RmsVal) : 0xFF;
+
+      switch (rmsState)
+      {
+        case (RMS_HIGH):
+            EventLog_Post(EVENT_RMS_HIGH, rmsTenths);
+            break;
+        case (RMS_LOW):
+            EventLog_Post(EVENT_RMS_LOW, rmsTenths);
+            break;
+        default:
+            EventLog_Post(EVENT_RMS_NORMAL, rmsTenths);
+            break;
+      }
+      lastRmsState = rmsState;
+    }
+
     // Depending on the timing type, adjust the alarm based on RMS.
-    switch (Logic_CheckRMS())
+    switch (rmsState)
     {
       case (RMS_FINE):
-          AlarmStopWatch.StopWatch = 0;
+          Logic_CancelAlarm();
           Logic_OutputAlarm(OFF);
           Logic_OutputRaise(OFF);
           Logic_OutputLower(OFF);
-          AlarmStopWatch.SetLevel = NOT_SET;
           break;
 
       // If RMS is high
@@ -303,6 +359,9 @@ int main(void)
 {
   /* Write your local variable definition here */
 
+  // Start timing the boot before anything else runs, BOOT_TIME reports it
+  Time_StartCounter();
+
   /*** Processor Expert internal initialization. DON'T REMOVE THIS CODE!!! ***/
   PE_low_level_init();
   /*** End of Processor Expert internal initialization.                    ***/
@@ -20,6 +20,17 @@ TPacket Packet;
 const uint8_t PACKET_ACK_MASK = 0x80;
 
 
+// PRIVATE FUNCTIONS
+
+/*! @brief Turns the blue LED off once the FTM channel 0 delay has run out.
+ *
+ *  @param pData is not used but is required by the FTM callback.
+ */
+static void PacketLEDOff(void* pData)
+{
+  LEDs_Off(LED_BLUE);
+}
+
 // PUBLIC FUNCTIONS
 
 bool Packet_Init(const uint32_t baudRate, const uint32_t moduleClk)
@@ -29,6 +40,8 @@ bool Packet_Init(const uint32_t baudRate, const uint32_t moduleClk)
   FTMChLoad[0].delayCount           = CPU_MCGFF_CLK_HZ_CONFIG_0;
   FTMChLoad[0].timerFunction        = TIMER_FUNCTION_OUTPUT_COMPARE;
   FTMChLoad[0].ioType.outputAction  = TIMER_OUTPUT_TOGGLE;  // Arbitrary decision (?)
+  FTMChLoad[0].userFunction         = PacketLEDOff;
+  FTMChLoad[0].userArguments        = NULL;
 
   // Set up FTM Channel 0
   FTM_Set(&FTMChLoad[0]);